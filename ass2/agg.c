@@ -0,0 +1,559 @@
+// agg.c ... grouped aggregation over tuples
+// part of Multi-attribute Linear-hashed Files
+// Hash aggregation that spills partitions to disk
+//   when its state outgrows a memory budget
+
+#include "defs.h"
+#include "agg.h"
+#include "hash.h"
+#include "bits.h"
+
+// An Agg groups tuples on one or more attributes and computes
+//   a list of aggregates for each group
+// - aggregates are "count", "countd:a", "min:a" and "max:a"
+//   where a is an attribute number
+// - min/max compare numerically if both values are integers,
+//   and as strings otherwise
+// - state lives in two hash tables: one entry per group, and
+//   one entry per (group,aggregate,value) for countd
+// - group keys are split into NPARTS partitions on their hash;
+//   if memory use passes the budget, the largest partition's
+//   state is written to a spill file, and later updates to that
+//   partition go straight to the file
+// - aggFinish() outputs the groups still in memory, then
+//   aggregates each spill file in turn, using the next PARTBITS
+//   bits of the hash to partition again if needed
+// - spill files hold one update per line:
+//     count \t groupkey \t slot \t slot ...
+//   with a slot for each aggregate that is either empty or
+//   '=' followed by a value; a tuple becomes an update with
+//   count 1, a spilled group an update with its count and
+//   min/max values, and a spilled countd entry an update with
+//   count 0 and just that value
+
+#define NPARTS    16     // spill partitions at each level
+#define PARTBITS  4      // hash bits used to pick a partition
+#define MAXLEVEL  (HASHBITS/PARTBITS)
+#define MAXAGGS   MAXATTRS
+
+#define AGG_COUNT  0
+#define AGG_COUNTD 1
+#define AGG_MIN    2
+#define AGG_MAX    3
+
+// entry in a group or distinct-value hash table
+typedef struct Entry {
+	struct Entry *next;  // next entry in hash chain
+	Bits   hash;         // hash of key
+	Bits   ghash;        // hash of the group part of key
+	int    klen;         // length of key
+	long   count;        // groups: #tuples in group
+	char  **acc;         // groups: min/max value for each aggregate
+	long  *ndist;        // groups: #distinct values for each aggregate
+	char   key[1];       // group: "v1,v2,..."
+	                     // distinct: "v1,v2,...\001k\001value"
+} Entry;
+
+typedef struct Table {
+	Entry **slot;        // hash chains
+	Count  nslots;       // always a power of 2
+	Count  nentries;
+} Table;
+
+// one change to the aggregate state
+typedef struct Update {
+	long   count;
+	char  *key;  int klen;
+	char  *slot[MAXAGGS];  int slen[MAXAGGS];  // slot NULL if empty
+} Update;
+
+struct AggRep {
+	Count  nattrs;       // #attributes in input tuples
+	Count  ngroup;       // #group-by attributes
+	Count  gatt[MAXATTRS];
+	Count  naggs;        // #aggregates
+	int    fn[MAXAGGS];  // function for each aggregate
+	Count  att[MAXAGGS]; // attribute for each aggregate
+	size_t mem;          // memory budget in bytes
+	size_t used;         // bytes of state in memory
+	size_t partsize[NPARTS];  // bytes of state in each partition
+	int    level;        // 0 for input, >0 for spill files
+	Table  groups;
+	Table  distinct;
+	FILE  *part[NPARTS]; // spill file, or NULL if in memory
+	Count  nspills;      // #partitions spilled here and below
+	char  *kbuf;  int ksize;  // group key being built (grown as needed)
+	char  *dbuf;  int dsize;  // distinct-value key being built
+};
+
+static Agg childAgg(Agg a);
+static char *scratch(char **buf, int *size, int need);
+static void applyUpdate(Agg a, Update *u);
+static void evict(Agg a);
+static Entry *lookup(Table *t, char *key, int klen, Bits h);
+static void insert(Table *t, Entry *e);
+static void freeEntry(Agg a, Entry *e);
+static int partOf(Agg a, Bits gh);
+static int orderVals(char *v1, int l1, char *v2, int l2);
+
+// set up an aggregation
+// groupby is a comma-separated list of attribute numbers
+// aggs is a comma-separated list of aggregates (see above)
+// returns NULL if either list is invalid
+
+Agg newAgg(Count nattrs, char *groupby, char *aggs, size_t mem)
+{
+	Agg a = malloc(sizeof(struct AggRep));
+	assert(a != NULL);
+	memset(a, 0, sizeof(struct AggRep));
+	a->nattrs = nattrs;
+	a->mem = mem;
+	char *c = groupby, *end;
+	while (*c != '\0') {
+		long n = strtol(c, &end, 10);
+		if (end == c || n < 0 || n >= nattrs || a->ngroup == MAXATTRS)
+			{ free(a); return NULL; }
+		a->gatt[a->ngroup++] = n;
+		c = end;
+		if (*c == ',') c++;
+		else if (*c != '\0') { free(a); return NULL; }
+	}
+	c = aggs;
+	while (*c != '\0') {
+		int fn; long n = 0;
+		if (strncmp(c, "count", 5) == 0 && (c[5] == ',' || c[5] == '\0'))
+			{ fn = AGG_COUNT; c += 5; }
+		else {
+			if (strncmp(c, "countd:", 7) == 0) { fn = AGG_COUNTD; c += 7; }
+			else if (strncmp(c, "min:", 4) == 0) { fn = AGG_MIN; c += 4; }
+			else if (strncmp(c, "max:", 4) == 0) { fn = AGG_MAX; c += 4; }
+			else { free(a); return NULL; }
+			n = strtol(c, &end, 10);
+			if (end == c || n < 0 || n >= nattrs) { free(a); return NULL; }
+			c = end;
+		}
+		if (a->naggs == MAXAGGS) { free(a); return NULL; }
+		a->fn[a->naggs] = fn;
+		a->att[a->naggs] = n;
+		a->naggs++;
+		if (*c == ',') c++;
+		else if (*c != '\0') { free(a); return NULL; }
+	}
+	if (a->ngroup == 0 || a->naggs == 0) { free(a); return NULL; }
+	return a;
+}
+
+// add one tuple (of len chars) to the aggregation
+
+void aggTuple(Agg a, Tuple t, int len)
+{
+	char *val[MAXATTRS];  int vlen[MAXATTRS];
+	char *key = scratch(&a->kbuf, &a->ksize, len+1);
+	Count i = 0;
+	char *c = t, *end = t + len;
+	for (;;) {
+		val[i] = c;
+		while (c < end && *c != ',') c++;
+		vlen[i] = c - val[i];
+		i++;
+		if (c == end || i == a->nattrs) break;
+		c++;
+	}
+	assert(i == a->nattrs);
+	// group key is the group-by values, comma-separated
+	Update u;
+	u.count = 1;
+	u.key = key;  u.klen = 0;
+	for (i = 0; i < a->ngroup; i++) {
+		Count g = a->gatt[i];
+		if (i > 0) key[u.klen++] = ',';
+		memcpy(key+u.klen, val[g], vlen[g]);
+		u.klen += vlen[g];
+	}
+	key[u.klen] = '\0';
+	for (i = 0; i < a->naggs; i++) {
+		if (a->fn[i] == AGG_COUNT)
+			u.slot[i] = NULL;
+		else {
+			u.slot[i] = val[a->att[i]];
+			u.slen[i] = vlen[a->att[i]];
+		}
+	}
+	applyUpdate(a, &u);
+}
+
+// write one line per group to out, as "groupkey,agg1,agg2,..."
+// returns the number of groups
+
+Count aggFinish(Agg a, FILE *out)
+{
+	Count ngroups = 0, s, i;
+	for (s = 0; s < a->groups.nslots; s++) {
+		Entry *e, *next;
+		for (e = a->groups.slot[s]; e != NULL; e = next) {
+			next = e->next;
+			fputs(e->key, out);
+			for (i = 0; i < a->naggs; i++) {
+				switch (a->fn[i]) {
+				case AGG_COUNT:  fprintf(out, ",%ld", e->count); break;
+				case AGG_COUNTD: fprintf(out, ",%ld", e->ndist[i]); break;
+				default:
+					fprintf(out, ",%s", e->acc[i] == NULL ? "" : e->acc[i]);
+				}
+			}
+			fputc('\n', out);
+			ngroups++;
+			freeEntry(a, e);
+		}
+		a->groups.slot[s] = NULL;
+	}
+	a->groups.nentries = 0;
+	for (s = 0; s < a->distinct.nslots; s++) {
+		Entry *e, *next;
+		for (e = a->distinct.slot[s]; e != NULL; e = next) {
+			next = e->next;
+			freeEntry(a, e);
+		}
+		a->distinct.slot[s] = NULL;
+	}
+	a->distinct.nentries = 0;
+
+	// now aggregate each spilled partition on its own
+	char *line = NULL;
+	int size = 0;
+	int p;
+	for (p = 0; p < NPARTS; p++) {
+		if (a->part[p] == NULL) continue;
+		Agg child = childAgg(a);
+		rewind(a->part[p]);
+		while (readLine(a->part[p], &line, &size) != NULL) {
+			Update u;
+			char *c = line;
+			u.count = strtol(c, &c, 10);
+			assert(*c == '\t');
+			u.key = ++c;
+			while (*c != '\t' && *c != '\0') c++;
+			u.klen = c - u.key;
+			for (i = 0; i < a->naggs; i++) {
+				assert(*c == '\t');
+				*c++ = '\0';
+				if (*c == '=') {
+					u.slot[i] = ++c;
+					while (*c != '\t' && *c != '\0') c++;
+					u.slen[i] = c - u.slot[i];
+				}
+				else
+					u.slot[i] = NULL;
+			}
+			*c = '\0';
+			applyUpdate(child, &u);
+		}
+		fclose(a->part[p]);
+		a->part[p] = NULL;
+		ngroups += aggFinish(child, out);
+		a->nspills += child->nspills;
+		freeAgg(child);
+	}
+	free(line);
+	return ngroups;
+}
+
+// number of partitions that were spilled to disk
+
+Count aggSpills(Agg a) { return a->nspills; }
+
+// release an aggregation's memory and spill files
+
+void freeAgg(Agg a)
+{
+	Count s;
+	int p;
+	for (s = 0; s < a->groups.nslots; s++) {
+		Entry *e, *next;
+		for (e = a->groups.slot[s]; e != NULL; e = next)
+			{ next = e->next; freeEntry(a, e); }
+	}
+	for (s = 0; s < a->distinct.nslots; s++) {
+		Entry *e, *next;
+		for (e = a->distinct.slot[s]; e != NULL; e = next)
+			{ next = e->next; freeEntry(a, e); }
+	}
+	free(a->groups.slot);
+	free(a->distinct.slot);
+	for (p = 0; p < NPARTS; p++)
+		if (a->part[p] != NULL) fclose(a->part[p]);
+	free(a->kbuf);
+	free(a->dbuf);
+	free(a);
+}
+
+// buffer of at least need bytes, kept in *buf (of *size bytes)
+
+static char *scratch(char **buf, int *size, int need)
+{
+	if (need > *size) {
+		*size = need < 256 ? 256 : need;
+		*buf = realloc(*buf, *size);
+		assert(*buf != NULL);
+	}
+	return *buf;
+}
+
+// new aggregation with the same grouping and aggregates,
+//   for the contents of a spill file
+
+static Agg childAgg(Agg a)
+{
+	Agg c = malloc(sizeof(struct AggRep));
+	assert(c != NULL);
+	memset(c, 0, sizeof(struct AggRep));
+	c->nattrs = a->nattrs;
+	c->ngroup = a->ngroup;
+	memcpy(c->gatt, a->gatt, sizeof(a->gatt));
+	c->naggs = a->naggs;
+	memcpy(c->fn, a->fn, sizeof(a->fn));
+	memcpy(c->att, a->att, sizeof(a->att));
+	c->mem = a->mem;
+	c->level = a->level + 1;
+	return c;
+}
+
+// write an update to a spill file
+
+static void writeUpdate(FILE *f, Count naggs, Update *u)
+{
+	Count i;
+	fprintf(f, "%ld\t%.*s", u->count, u->klen, u->key);
+	for (i = 0; i < naggs; i++) {
+		fputc('\t', f);
+		if (u->slot[i] != NULL)
+			fprintf(f, "=%.*s", u->slen[i], u->slot[i]);
+	}
+	fputc('\n', f);
+}
+
+// apply an update to the in-memory state, or pass it
+//   on to its partition's spill file
+
+static void applyUpdate(Agg a, Update *u)
+{
+	Bits gh = hash_any((unsigned char *)u->key, u->klen);
+	int p = partOf(a, gh);
+	if (a->part[p] != NULL) {
+		writeUpdate(a->part[p], a->naggs, u);
+		return;
+	}
+	Entry *g = lookup(&a->groups, u->key, u->klen, gh);
+	if (g == NULL) {
+		size_t size = sizeof(Entry) + u->klen
+		              + a->naggs*(sizeof(char *)+sizeof(long));
+		g = malloc(size);
+		assert(g != NULL);
+		g->hash = g->ghash = gh;
+		g->klen = u->klen;
+		memcpy(g->key, u->key, u->klen);
+		g->key[u->klen] = '\0';
+		g->count = 0;
+		g->acc = calloc(a->naggs, sizeof(char *));
+		g->ndist = calloc(a->naggs, sizeof(long));
+		assert(g->acc != NULL && g->ndist != NULL);
+		insert(&a->groups, g);
+		a->used += size;
+		a->partsize[p] += size;
+	}
+	g->count += u->count;
+	Count i;
+	for (i = 0; i < a->naggs; i++) {
+		if (u->slot[i] == NULL) continue;
+		char *v = u->slot[i];  int vlen = u->slen[i];
+		if (a->fn[i] == AGG_MIN || a->fn[i] == AGG_MAX) {
+			char *cur = g->acc[i];
+			if (cur != NULL) {
+				int cmp = orderVals(v, vlen, cur, strlen(cur));
+				if (a->fn[i] == AGG_MIN ? cmp >= 0 : cmp <= 0) continue;
+				a->used -= strlen(cur)+1;
+				a->partsize[p] -= strlen(cur)+1;
+				free(cur);
+			}
+			g->acc[i] = malloc(vlen+1);
+			assert(g->acc[i] != NULL);
+			memcpy(g->acc[i], v, vlen);
+			g->acc[i][vlen] = '\0';
+			a->used += vlen+1;
+			a->partsize[p] += vlen+1;
+		}
+		else if (a->fn[i] == AGG_COUNTD) {
+			char *dkey = scratch(&a->dbuf, &a->dsize, g->klen+vlen+16);
+			int dlen = sprintf(dkey, "%s\001%d\001", g->key, (int)i);
+			memcpy(dkey+dlen, v, vlen);
+			dlen += vlen;
+			dkey[dlen] = '\0';
+			Bits dh = hash_any((unsigned char *)dkey, dlen);
+			if (lookup(&a->distinct, dkey, dlen, dh) != NULL) continue;
+			size_t size = sizeof(Entry) + dlen;
+			Entry *d = malloc(size);
+			assert(d != NULL);
+			d->hash = dh;  d->ghash = gh;
+			d->klen = dlen;
+			memcpy(d->key, dkey, dlen+1);
+			d->acc = NULL;  d->ndist = NULL;
+			insert(&a->distinct, d);
+			a->used += size;
+			a->partsize[p] += size;
+			g->ndist[i]++;
+		}
+	}
+	if (a->used > a->mem) evict(a);
+}
+
+// write the largest in-memory partition to a spill file
+
+static void evict(Agg a)
+{
+	// out of hash bits to partition on; just use more memory
+	if (a->level >= MAXLEVEL) return;
+	int p, victim = -1;
+	for (p = 0; p < NPARTS; p++) {
+		if (a->part[p] != NULL || a->partsize[p] == 0) continue;
+		if (victim < 0 || a->partsize[p] > a->partsize[victim]) victim = p;
+	}
+	if (victim < 0) return;
+	FILE *f = tmpfile();
+	if (f == NULL) fatal("Can't create aggregation spill file");
+
+	Count s, i;
+	// spill groups as partial aggregates
+	for (s = 0; s < a->groups.nslots; s++) {
+		Entry **prev = &a->groups.slot[s], *e;
+		while ((e = *prev) != NULL) {
+			if (partOf(a, e->ghash) != victim) { prev = &e->next; continue; }
+			Update u;
+			u.count = e->count;
+			u.key = e->key;  u.klen = e->klen;
+			for (i = 0; i < a->naggs; i++) {
+				u.slot[i] = (a->fn[i] == AGG_MIN || a->fn[i] == AGG_MAX)
+				            ? e->acc[i] : NULL;
+				if (u.slot[i] != NULL) u.slen[i] = strlen(u.slot[i]);
+			}
+			writeUpdate(f, a->naggs, &u);
+			*prev = e->next;
+			a->groups.nentries--;
+			freeEntry(a, e);
+		}
+	}
+	// spill distinct values as count-0 updates
+	for (s = 0; s < a->distinct.nslots; s++) {
+		Entry **prev = &a->distinct.slot[s], *e;
+		while ((e = *prev) != NULL) {
+			if (partOf(a, e->ghash) != victim) { prev = &e->next; continue; }
+			Update u;
+			u.count = 0;
+			u.key = e->key;
+			u.klen = strchr(e->key, '\001') - e->key;
+			char *c = e->key + u.klen + 1;
+			int k = strtol(c, &c, 10);
+			for (i = 0; i < a->naggs; i++) u.slot[i] = NULL;
+			u.slot[k] = c+1;
+			u.slen[k] = e->klen - (u.slot[k] - e->key);
+			writeUpdate(f, a->naggs, &u);
+			*prev = e->next;
+			a->distinct.nentries--;
+			freeEntry(a, e);
+		}
+	}
+	a->part[victim] = f;
+	a->nspills++;
+}
+
+// find entry with key in a hash table
+
+static Entry *lookup(Table *t, char *key, int klen, Bits h)
+{
+	if (t->nslots == 0) return NULL;
+	Entry *e;
+	for (e = t->slot[h & (t->nslots-1)]; e != NULL; e = e->next) {
+		if (e->hash == h && e->klen == klen && memcmp(e->key, key, klen) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+// add entry to a hash table, doubling it when chains get long
+
+static void insert(Table *t, Entry *e)
+{
+	if (t->nentries >= 2*t->nslots) {
+		Count n = t->nslots == 0 ? 1024 : 2*t->nslots, s;
+		Entry **slot = calloc(n, sizeof(Entry *));
+		assert(slot != NULL);
+		for (s = 0; s < t->nslots; s++) {
+			Entry *x, *next;
+			for (x = t->slot[s]; x != NULL; x = next) {
+				next = x->next;
+				x->next = slot[x->hash & (n-1)];
+				slot[x->hash & (n-1)] = x;
+			}
+		}
+		free(t->slot);
+		t->slot = slot;
+		t->nslots = n;
+	}
+	e->next = t->slot[e->hash & (t->nslots-1)];
+	t->slot[e->hash & (t->nslots-1)] = e;
+	t->nentries++;
+}
+
+// release an entry (already unlinked) and account for its memory
+
+static void freeEntry(Agg a, Entry *e)
+{
+	size_t size = sizeof(Entry) + e->klen;
+	if (e->acc != NULL) {
+		Count i;
+		size += a->naggs*(sizeof(char *)+sizeof(long));
+		for (i = 0; i < a->naggs; i++) {
+			if (e->acc[i] == NULL) continue;
+			size += strlen(e->acc[i])+1;
+			free(e->acc[i]);
+		}
+		free(e->acc);
+		free(e->ndist);
+	}
+	a->used -= size;
+	a->partsize[partOf(a, e->ghash)] -= size;
+	free(e);
+}
+
+// partition for a group hash at this aggregation's level
+// uses high-order bits, so tables (which use low-order bits)
+//   stay well spread within a partition
+
+static int partOf(Agg a, Bits gh)
+{
+	int shift = HASHBITS - (a->level+1)*PARTBITS;
+	if (shift < 0) return 0;
+	return (gh >> shift) & (NPARTS-1);
+}
+
+// compare two values, as integers if both look like integers
+
+static int orderVals(char *v1, int l1, char *v2, int l2)
+{
+	int i, num = (l1 > 0 && l2 > 0 && l1 < 19 && l2 < 19);
+	for (i = 0; num && i < l1; i++)
+		if (!(v1[i] >= '0' && v1[i] <= '9') && !(i == 0 && v1[i] == '-' && l1 > 1)) num = 0;
+	for (i = 0; num && i < l2; i++)
+		if (!(v2[i] >= '0' && v2[i] <= '9') && !(i == 0 && v2[i] == '-' && l2 > 1)) num = 0;
+	if (num) {
+		long long n1 = 0, n2 = 0;
+		for (i = (v1[0] == '-'); i < l1; i++) n1 = 10*n1 + (v1[i]-'0');
+		for (i = (v2[0] == '-'); i < l2; i++) n2 = 10*n2 + (v2[i]-'0');
+		if (v1[0] == '-') n1 = -n1;
+		if (v2[0] == '-') n2 = -n2;
+		return (n1 < n2) ? -1 : (n1 > n2);
+	}
+	int n = l1 < l2 ? l1 : l2;
+	int cmp = memcmp(v1, v2, n);
+	if (cmp != 0) return cmp;
+	return l1 - l2;
+}
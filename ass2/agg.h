@@ -0,0 +1,19 @@
+// agg.h ... interface to grouped aggregation
+// part of Multi-attribute Linear-hashed Files
+// See agg.c for details of Agg type and functions
+
+#ifndef AGG_H
+#define AGG_H 1
+
+typedef struct AggRep *Agg;
+
+#include "defs.h"
+#include "tuple.h"
+
+Agg newAgg(Count nattrs, char *groupby, char *aggs, size_t mem);
+void aggTuple(Agg a, Tuple t, int len);
+Count aggFinish(Agg a, FILE *out);
+Count aggSpills(Agg a);
+void freeAgg(Agg a);
+
+#endif
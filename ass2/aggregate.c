@@ -0,0 +1,125 @@
+// aggregate.c ... grouped aggregation over a query
+// part of Multi-attribute linear-hashed files
+// Groups the tuples matching a query and computes aggregates
+// Usage:  ./aggregate  [-v]  [-m KB]  RelName  v1,v2,...  GroupBy  Aggs
+// where v1,v2,... is a query, as for ./select
+//       GroupBy = attribute numbers, e.g. 1,2
+//       Aggs = list of count, countd:a, min:a, max:a
+//       -m KB = memory budget for aggregation state (default 65536)
+// Output is one line per group: groupvals,agg1,agg2,...
+// A partitioned relation's partitions are aggregated together
+
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#include "defs.h"
+#include "query.h"
+#include "reln.h"
+#include "agg.h"
+#include "part.h"
+
+#define USAGE "./aggregate  [-v]  [-m KB]  RelName  v1,v2,...  GroupBy  Aggs"
+#define BATCHSIZE 256
+
+// Main ... process args, run query, aggregate its results
+
+int main(int argc, char **argv)
+{
+	Reln r;  // handle on the open relation
+	Query q;  // processed version of query string
+	Agg agg;  // aggregation state
+	char err[MAXERRMSG];  // buffer for error messages
+	int verbose = 0;  // show extra info on aggregation
+	long memKB = 65536;  // memory budget
+
+	// process command-line args
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[arg], "-m") == 0 && arg+1 < argc) {
+			memKB = atol(argv[++arg]);
+			if (memKB < 1) fatal(USAGE);
+		}
+		else
+			fatal(USAGE);
+		arg++;
+	}
+	if (argc - arg < 4) fatal(USAGE);
+	char *rname = argv[arg], *qstr = argv[arg+1];
+	char *groupby = argv[arg+2], *aggs = argv[arg+3];
+
+	// initialise relation, scan and aggregation
+
+	// the partitions of a partitioned relation that the query can
+	//   match are scanned in turn, into the one aggregation
+
+	Parts parts = NULL;
+	Count *which = NULL;
+	int nscan = 1;
+	if (isPartitioned(rname)) {
+		if ((parts = openParts(rname,"r")) == NULL) {
+			sprintf(err, "Can't open partitions of relation: %s",rname);
+			fatal(err);
+		}
+		which = malloc(nparts(parts)*sizeof(Count));
+		assert(which != NULL);
+		if ((nscan = queryParts(parts, qstr, which)) < 0) {
+			sprintf(err, "Invalid query: %s",qstr);
+			fatal(err);
+		}
+		r = partReln(parts, 0);
+	}
+	else if (!existsRelation(rname)) {
+		sprintf(err, "No such relation: %s",rname);
+		fatal(err);
+	}
+	else if ((r = openRelation(rname,"r")) == NULL) {
+		sprintf(err, "Can't open relation: %s",rname);
+		fatal(err);
+	}
+	if ((agg = newAgg(nattrs(r), groupby, aggs, memKB*1024)) == NULL)
+		fatal("Invalid group-by or aggregate list");
+
+	// feed matching tuples to the aggregation, then output groups
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	TupleRef refs[BATCHSIZE];
+	long ntuples = 0;
+	int n, i;
+	for (int p = 0; p < nscan; p++) {
+		Reln pr = (parts == NULL) ? r : partReln(parts, which[p]);
+		if ((q = startQuery(pr, qstr)) == NULL) {
+			sprintf(err, "Invalid query: %s",qstr);
+			fatal(err);
+		}
+		while ((n = getNextTuples(q, refs, BATCHSIZE)) > 0) {
+			for (i = 0; i < n; i++) aggTuple(agg, refs[i].tup, refs[i].len);
+			ntuples += n;
+		}
+		closeQuery(q);
+	}
+	Count ngroups = aggFinish(agg, stdout);
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (verbose) {
+		double secs = (end.tv_sec - start.tv_sec)
+		              + (end.tv_nsec - start.tv_nsec)/1e9;
+		fprintf(stderr, "%ld tuples, %d groups, %d spilled partitions, %.3fs\n",
+		        ntuples, ngroups, aggSpills(agg), secs);
+	}
+
+	// clean up
+
+	freeAgg(agg);
+	if (parts != NULL) {
+		free(which);
+		closeParts(parts);
+	}
+	else
+		closeRelation(r);
+
+	return 0;
+}
@@ -0,0 +1,280 @@
+// benchcmp.c ... compare benchmark results against a baseline
+// part of Multi-attribute linear-hashed files
+// Reads the JSON results of several runs of ./benchmark or
+//   ./microbench for a baseline and for a new version, and shows
+//   how each timing changed
+// Usage:  ./benchcmp  [-t pct]  [-a]  Base.json ...  --  New.json ...
+// where -t pct = smallest change counted as a regression (default 5)
+//       -a = show every metric, not just timings
+// Exits with status 1 if any timing got worse
+// A timing got worse if it changed by more than pct% in the bad
+//   direction and, when there are two or more runs on each side,
+//   the 95% confidence interval of the change (Welch's t) is all on
+//   the bad side of zero; changes of more than pct% that are within
+//   the noise are marked "noise"
+// "make baseline" and "make benchcheck" keep and compare runs
+
+#include <math.h>
+#include "defs.h"
+
+#define USAGE "./benchcmp  [-t pct]  [-a]  Base.json ...  --  New.json ..."
+#define MAXMETRICS 256   // distinct metrics over all files
+#define MAXRUNS 64       // files on each side
+#define MAXNAME 96       // longest metric name (dotted JSON path)
+
+#define BASE 0
+#define NEW 1
+
+// values of one metric over the runs on each side
+typedef struct Metric {
+	char name[MAXNAME];
+	int n[2];                 // runs that have it, on each side
+	double val[2][MAXRUNS];
+} Metric;
+
+static Metric metrics[MAXMETRICS];
+static int nmetrics = 0;
+
+// record value v of metric name from a run on side s
+
+static void addValue(char *name, double v, int s)
+{
+	int i;
+	for (i = 0; i < nmetrics; i++) {
+		if (strcmp(metrics[i].name, name) == 0) break;
+	}
+	if (i == nmetrics) {
+		if (nmetrics == MAXMETRICS) fatal("Too many metrics");
+		strcpy(metrics[i].name, name);
+		metrics[i].n[BASE] = metrics[i].n[NEW] = 0;
+		nmetrics++;
+	}
+	Metric *m = &metrics[i];
+	if (m->n[s] < MAXRUNS) m->val[s][m->n[s]++] = v;
+}
+
+// JSON parsing, just enough for the results files; every number
+//   is recorded under its path, e.g. select.point.latency_us.p50
+
+static void skipSpace(char **s)
+{
+	while (**s == ' ' || **s == '\t' || **s == '\n' || **s == '\r') (*s)++;
+}
+
+// copy the string at *s (without quotes or escapes) into buf
+
+static void parseString(char **s, char *buf, int size)
+{
+	int len = 0;
+	if (**s != '"') fatal("Bad JSON: string expected");
+	(*s)++;
+	while (**s != '"') {
+		if (**s == '\0') fatal("Bad JSON: unterminated string");
+		if (**s == '\\' && (*s)[1] != '\0') (*s)++;
+		if (len < size-1) buf[len++] = **s;
+		(*s)++;
+	}
+	(*s)++;
+	buf[len] = '\0';
+}
+
+static void parseValue(char **s, char *path, int side)
+{
+	char key[MAXNAME], sub[MAXNAME];
+	skipSpace(s);
+	if (**s == '{' || **s == '[') {
+		char close = (**s == '{') ? '}' : ']';
+		int index = 0;
+		(*s)++;
+		skipSpace(s);
+		while (**s != close) {
+			if (close == '}') {
+				parseString(s, key, MAXNAME);
+				skipSpace(s);
+				if (**s != ':') fatal("Bad JSON: ':' expected");
+				(*s)++;
+			}
+			else
+				sprintf(key, "%d", index++);
+			snprintf(sub, MAXNAME, "%s%s%s", path, *path ? "." : "", key);
+			parseValue(s, sub, side);
+			skipSpace(s);
+			if (**s == ',') { (*s)++; skipSpace(s); }
+			else if (**s != close) fatal("Bad JSON: ',' expected");
+		}
+		(*s)++;
+	}
+	else if (**s == '"')
+		parseString(s, key, MAXNAME);
+	else if (strncmp(*s, "true", 4) == 0 || strncmp(*s, "null", 4) == 0)
+		*s += 4;
+	else if (strncmp(*s, "false", 5) == 0)
+		*s += 5;
+	else {
+		char *end;
+		double v = strtod(*s, &end);
+		if (end == *s) fatal("Bad JSON: value expected");
+		*s = end;
+		addValue(path, v, side);
+	}
+}
+
+// read all of the results in file fname, from a run on side s
+
+static void readResults(char *fname, int s)
+{
+	char err[MAXERRMSG];
+	FILE *f = fopen(fname, "r");
+	if (f == NULL) {
+		snprintf(err, MAXERRMSG, "Can't open %s", fname);
+		fatal(err);
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	rewind(f);
+	char *buf = malloc(size+1);
+	assert(buf != NULL);
+	size = fread(buf, 1, size, f);
+	buf[size] = '\0';
+	fclose(f);
+	char *c = buf;
+	parseValue(&c, "", s);
+	free(buf);
+}
+
+// does name end with suffix?
+
+static Bool endsWith(char *name, char *suffix)
+{
+	int n = strlen(name), k = strlen(suffix);
+	return n >= k && strcmp(name + n - k, suffix) == 0;
+}
+
+// is a bigger value of the metric better (+1), worse (-1),
+//   or neither, i.e. not a timing (0)?
+// latency min, max and counts are too noisy, or not timings
+
+static int direction(char *name)
+{
+	if (strstr(name, "per_sec") != NULL) return +1;
+	if (endsWith(name, ".min") || endsWith(name, ".max") || endsWith(name, ".n"))
+		return 0;
+	if (strstr(name, "latency_us") != NULL || strstr(name, "ns_per_op") != NULL
+	    || endsWith(name, "secs") || endsWith(name, "pages_per_query"))
+		return -1;
+	return 0;
+}
+
+// two-sided 95% point of Student's t with df degrees of freedom
+
+static double tValue(double df)
+{
+	static double t[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447,
+	                      2.365, 2.306, 2.262, 2.228, 2.201, 2.179,
+	                      2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+	                      2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+	                      2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+	int d = (int)df;
+	if (d < 1) d = 1;
+	return (d <= 30) ? t[d-1] : 1.960;
+}
+
+static void meanVar(double *v, int n, double *mean, double *var)
+{
+	double sum = 0, ss = 0;
+	for (int i = 0; i < n; i++) sum += v[i];
+	*mean = sum/n;
+	for (int i = 0; i < n; i++) ss += (v[i] - *mean)*(v[i] - *mean);
+	*var = (n > 1) ? ss/(n-1) : 0;
+}
+
+// Main ... process args, read results, show changes
+
+int main(int argc, char **argv)
+{
+	double thresh = 5;  // % change counted as a regression
+	Bool all = FALSE;   // show non-timing metrics too
+
+	// process command-line args
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-' && strcmp(argv[arg], "--") != 0) {
+		if (strcmp(argv[arg], "-t") == 0 && arg+1 < argc)
+			thresh = atof(argv[++arg]);
+		else if (strcmp(argv[arg], "-a") == 0)
+			all = TRUE;
+		else
+			fatal(USAGE);
+		arg++;
+	}
+	int side = BASE, nfiles[2] = {0, 0};
+	for (; arg < argc; arg++) {
+		if (strcmp(argv[arg], "--") == 0 && side == BASE)
+			side = NEW;
+		else {
+			readResults(argv[arg], side);
+			nfiles[side]++;
+		}
+	}
+	if (nfiles[BASE] == 0 || nfiles[NEW] == 0 || thresh < 0) fatal(USAGE);
+
+	// compare each metric found on both sides
+
+	printf("%d baseline file(s), %d new file(s), threshold %.1f%%\n",
+	       nfiles[BASE], nfiles[NEW], thresh);
+	printf("%-40s %12s %12s %8s %8s  %s\n",
+	       "metric", "base", "new", "change", "+/-", "verdict");
+	int nworse = 0;
+	for (int i = 0; i < nmetrics; i++) {
+		Metric *m = &metrics[i];
+		int dir = direction(m->name);
+		if (m->n[BASE] == 0 || m->n[NEW] == 0 || (dir == 0 && !all))
+			continue;
+		double mb, vb, mn, vn;
+		meanVar(m->val[BASE], m->n[BASE], &mb, &vb);
+		meanVar(m->val[NEW], m->n[NEW], &mn, &vn);
+		if (mb == 0) {
+			printf("%-40s %12.4g %12.4g %8s %8s  %s\n",
+			       m->name, mb, mn, "-", "-", "");
+			continue;
+		}
+		double change = 100*(mn - mb)/mb;
+		// half-width of the 95% confidence interval of the change,
+		//   when both sides have enough runs to estimate noise
+		double ci = -1;
+		if (m->n[BASE] > 1 && m->n[NEW] > 1) {
+			double eb = vb/m->n[BASE], en = vn/m->n[NEW];
+			double se = sqrt(eb + en);
+			double df = (eb + en == 0) ? 1e9
+			            : (eb + en)*(eb + en) / (eb*eb/(m->n[BASE]-1)
+			                                     + en*en/(m->n[NEW]-1));
+			ci = 100*tValue(df)*se/mb;
+		}
+		char *verdict = "";
+		if (dir != 0) {
+			double bad = -dir*change;  // > 0 when it got worse
+			Bool beyond = (ci < 0 || fabs(change) > ci);
+			if (fabs(change) <= thresh)
+				verdict = "ok";
+			else if (!beyond)
+				verdict = "noise";
+			else if (bad > 0) {
+				verdict = "WORSE";
+				nworse++;
+			}
+			else
+				verdict = "better";
+		}
+		char cis[16];
+		if (ci < 0)
+			strcpy(cis, "-");
+		else
+			snprintf(cis, sizeof(cis), "%.1f%%", ci);
+		printf("%-40s %12.4g %12.4g %+7.1f%% %8s  %s\n",
+		       m->name, mb, mn, change, cis, verdict);
+	}
+	if (nworse > 0)
+		printf("%d metric(s) got worse\n", nworse);
+
+	return nworse > 0 ? 1 : 0;
+}
@@ -0,0 +1,243 @@
+// benchmark.c ... time the main operations on a relation
+// part of Multi-attribute linear-hashed files
+// Inserts the tuples on stdin into a relation (made by ./create),
+//   then times the inserts, splits, point/partial-match/full
+//   queries and a dump, and writes the results as JSON
+// Usage:  ./benchmark  [-o File]  [-q N]  [-s Seed]  RelName  <  tuples
+// where -o File = where the JSON goes (default stdout)
+//       -q N = queries of each kind to time (default 200)
+//       -s Seed = picks the tuples queried for (default 1)
+// Latencies are in microseconds; inserts that split a bucket are
+//   reported under "split", not "insert"
+// "make bench" runs this on tuples from ./gendata
+
+#include "defs.h"
+#include "reln.h"
+#include "tuple.h"
+#include "query.h"
+#include "page.h"
+#include "lob.h"
+
+#define USAGE "./benchmark  [-o File]  [-q N]  [-s Seed]  RelName  <  tuples"
+#define BATCHSIZE 256   // tuple refs fetched per scan call
+
+// kinds of query timed
+#define POINT_QUERY 0    // every attribute known
+#define PARTIAL_QUERY 1  // some attributes known
+#define FULL_QUERY 2     // no attributes known
+#define NQUERYKINDS 3
+
+static char *queryKind[NQUERYKINDS] = { "point", "partial", "full" };
+
+// form a query string of kind k from tuple t into q
+
+static void makeQuery(Tuple t, Count nattrs, int k,
+                      unsigned long long *rng, char *q)
+{
+	char **vals = malloc(nattrs*sizeof(char *));
+	assert(vals != NULL);
+	tupleVals(t, vals);
+	Count mask = 0, all = (nattrs >= 32) ? ~0U : (1U << nattrs) - 1;
+	if (k == POINT_QUERY)
+		mask = all;
+	else if (k == PARTIAL_QUERY) {
+		// some, but not all, attributes known (when there's a choice)
+		mask = nextRandom(rng) & all;
+		if (mask == 0) mask = 1;
+		if (mask == all && nattrs > 1) mask &= ~1U;
+	}
+	char *c = q;
+	for (Count a = 0; a < nattrs; a++) {
+		if (a > 0) *c++ = ',';
+		if (a < 32 && (mask & (1U << a)))
+			c += sprintf(c, "%s", vals[a]);
+		else
+			*c++ = '?';
+	}
+	*c = '\0';
+	freeVals(vals, nattrs);
+	free(vals);
+}
+
+// Main ... process args, build relation, time operations
+
+int main(int argc, char **argv)
+{
+	Reln r;  // handle on the relation
+	char err[MAXERRMSG];  // buffer for error messages
+	FILE *out = stdout;   // where the results go
+	long nq = 200;        // queries of each kind
+	unsigned long long seed = 1;  // picks tuples to query for
+
+	// process command-line args
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-o") == 0 && arg+1 < argc) {
+			if ((out = fopen(argv[++arg], "w")) == NULL)
+				fatal("Can't open output file");
+		}
+		else if (strcmp(argv[arg], "-q") == 0 && arg+1 < argc) {
+			nq = atol(argv[++arg]);
+			if (nq < 1) fatal(USAGE);
+		}
+		else if (strcmp(argv[arg], "-s") == 0 && arg+1 < argc)
+			seed = strtoull(argv[++arg], NULL, 10);
+		else
+			fatal(USAGE);
+		arg++;
+	}
+	if (argc - arg < 1) fatal(USAGE);
+	char *rname = argv[arg];
+	if (seed == 0) seed = 1;  // xorshift never leaves 0
+
+	// open the relation, and read all of the tuples first, so
+	//   that reading them isn't timed
+
+	if (!existsRelation(rname)) {
+		sprintf(err, "No such relation: %s",rname);
+		fatal(err);
+	}
+	if ((r = openRelation(rname,"r+")) == NULL) {
+		sprintf(err, "Can't open relation: %s",rname);
+		fatal(err);
+	}
+	Count nattr = nattrs(r);
+	long ntups = 0, maxtups = 1024;
+	Tuple *tups = malloc(maxtups*sizeof(Tuple));
+	assert(tups != NULL);
+	Tuple t;
+	long nbytes = 0, maxlen = 0;
+	while ((t = readTuple(r, stdin)) != NULL) {
+		if (ntups == maxtups) {
+			maxtups *= 2;
+			tups = realloc(tups, maxtups*sizeof(Tuple));
+			assert(tups != NULL);
+		}
+		long len = strlen(t);
+		nbytes += len + 1;
+		if (len > maxlen) maxlen = len;
+		tups[ntups++] = t;
+	}
+	if (ntups == 0) fatal("No tuples on stdin");
+
+	// insert, separating out inserts that caused a split
+	// (a split adds a bucket, so npages goes up)
+
+	double *lat = malloc(ntups*sizeof(double));
+	double *slat = malloc(ntups*sizeof(double));
+	assert(lat != NULL && slat != NULL);
+	long nsplit = 0, nplain = 0;
+	double splitSecs = 0;
+	double start = now();
+	for (long i = 0; i < ntups; i++) {
+		Count before = npages(r);
+		double t0 = now();
+		if (addToRelation(r, tups[i]) == NO_PAGE) {
+			sprintf(err, "Insert of %.*s failed", MAXERRMSG/2, tups[i]);
+			fatal(err);
+		}
+		double dt = now() - t0;
+		if (npages(r) != before) {
+			slat[nsplit++] = dt;
+			splitSecs += dt;
+		}
+		else
+			lat[nplain++] = dt;
+	}
+	closeRelation(r);
+	double insertSecs = now() - start;
+
+	r = openRelation(rname, "r");
+	assert(r != NULL);
+	fprintf(out, "{\n");
+	fprintf(out, "  \"relation\": \"%s\", \"nattrs\": %d, \"layout\": \"%s\", "
+	        "\"scheme\": \"%s\",\n", rname, nattr,
+	        layout(r) == PAX_LAYOUT ? "pax" : "row",
+	        hashScheme(r) == SPIRAL_HASH ? "spiral" :
+	        hashScheme(r) == EXTENDIBLE_HASH ? "extendible" : "linear");
+	fprintf(out, "  \"ntuples\": %d, \"npages\": %d, \"depth\": %d,\n",
+	        ntuples(r), npages(r), depth(r));
+	fprintf(out, "  \"insert\": {\"tuples\": %ld, \"bytes\": %ld, \"secs\": %.6f, "
+	        "\"tuples_per_sec\": %.0f, \"bytes_per_sec\": %.0f,\n"
+	        "    \"latency_us\": ",
+	        ntups, nbytes, insertSecs, ntups/insertSecs, nbytes/insertSecs);
+	putLatency(out, lat, nplain);
+	fprintf(out, "},\n");
+	fprintf(out, "  \"split\": {\"splits\": %ld, \"secs\": %.6f,\n"
+	        "    \"latency_us\": ", nsplit, splitSecs);
+	putLatency(out, slat, nsplit);
+	fprintf(out, "},\n");
+	free(slat);
+
+	// time each kind of query on tuples picked at random, from
+	//   startQuery() until the last match is fetched
+
+	fprintf(out, "  \"select\": {\n");
+	lat = realloc(lat, nq*sizeof(double));
+	assert(lat != NULL);
+	char *q = malloc(maxlen + nattr + 1);  // "?" may replace ""
+	assert(q != NULL);
+	TupleRef refs[BATCHSIZE];
+	for (int k = 0; k < NQUERYKINDS; k++) {
+		unsigned long long rng = seed;
+		long found = 0;
+		Count pages = pagesRead();
+		// full scans all read the whole relation, so a few will do
+		long n = (k == FULL_QUERY && nq > 10) ? 10 : nq;
+		for (long i = 0; i < n; i++) {
+			makeQuery(tups[nextRandom(&rng) % ntups], nattr, k, &rng, q);
+			double t0 = now();
+			Query qry = startQuery(r, q);
+			int got;
+			while ((got = getNextTuples(qry, refs, BATCHSIZE)) > 0)
+				found += got;
+			closeQuery(qry);
+			lat[i] = now() - t0;
+		}
+		fprintf(out, "    \"%s\": {\"queries\": %ld, \"tuples_per_query\": %.1f, "
+		        "\"pages_per_query\": %.1f,\n      \"latency_us\": ",
+		        queryKind[k], n, (double)found/n,
+		        (double)(pagesRead() - pages)/n);
+		putLatency(out, lat, n);
+		fprintf(out, "}%s\n", k < NQUERYKINDS-1 ? "," : "");
+	}
+	fprintf(out, "  },\n");
+	free(q);
+	free(lat);
+
+	// dump every tuple, as ./dump does, to /dev/null
+
+	FILE *sink = fopen("/dev/null", "w");
+	assert(sink != NULL);
+	char *buf = NULL;
+	int size = 0;
+	long ndump = 0, dbytes = 0;
+	start = now();
+	for (PageID b = 0; b < npages(r); b++) {
+		for (Page p = firstBucketPage(r, b); p != NULL; p = nextBucketPage(r, p)) {
+			PageScan scan;
+			startPageScan(&scan, p, nattrs(r), layout(r));
+			while ((t = nextPageTuple(&scan)) != NULL) {
+				dbytes += fprintf(sink, "%s\n", lobResolve(lobFile(r), t, &buf, &size));
+				ndump++;
+			}
+		}
+	}
+	double dumpSecs = now() - start;
+	fclose(sink);
+	free(buf);
+	fprintf(out, "  \"dump\": {\"tuples\": %ld, \"bytes\": %ld, \"secs\": %.6f, "
+	        "\"tuples_per_sec\": %.0f, \"bytes_per_sec\": %.0f}\n",
+	        ndump, dbytes, dumpSecs, ndump/dumpSecs, dbytes/dumpSecs);
+	fprintf(out, "}\n");
+
+	// clean up
+
+	if (out != stdout) fclose(out);
+	closeRelation(r);
+	for (long i = 0; i < ntups; i++) free(tups[i]);
+	free(tups);
+
+	return 0;
+}
@@ -1,55 +1,57 @@
 // bits.c ... functions on bit-strings
 // part of Multi-attribute Linear-hashed Files
-// Bit-strings are 32-bit unsigned quantities
+// Bit-strings are 64-bit unsigned quantities
+// (attribute hashes, which are 32-bit, can be passed too)
 // Last modified by John Shepherd, July 2019
 
 #include <assert.h>
+#include "defs.h"
 #include "bits.h"
 
 // check if the bit at position is 1
 
-int bitIsSet(Bits val, int position)
+int bitIsSet(HashBits val, int position)
 {
-	assert(0 <= position && position <= 31);
-	Bits mask = (1 << position);
+	assert(0 <= position && position < MAXBITS);
+	HashBits mask = ((HashBits)1 << position);
 	return ((val & mask) != 0);
 }
 
 // set the bit at position to 1
 
-Bits setBit(Bits val, int position)
+HashBits setBit(HashBits val, int position)
 {
-	assert(0 <= position && position <= 31);
-	Bits mask = (1 << position);
+	assert(0 <= position && position < MAXBITS);
+	HashBits mask = ((HashBits)1 << position);
 	return (val | mask);
 }
 
 // set the bit at position to 0
 
-Bits unsetBit(Bits val, int position)
+HashBits unsetBit(HashBits val, int position)
 {
-	assert(0 <= position && position <= 31);
-	Bits mask = (~(1 << position));
+	assert(0 <= position && position < MAXBITS);
+	HashBits mask = (~((HashBits)1 << position));
 	return (val & mask);
 }
 
 // extract just lower-order n bits
 
-Bits getLower(Bits b, int n)
+HashBits getLower(HashBits b, int n)
 {
-	assert(1 <= n && n <= 32);
-	int i; Bits mask = 0;
-	for (i = 0; i < n; i++) mask |= (1<<i);
+	assert(1 <= n && n <= MAXBITS);
+	int i; HashBits mask = 0;
+	for (i = 0; i < n; i++) mask |= ((HashBits)1<<i);
 	return b&mask;
 }
 
-// convert 32-bit unsigned quantity to string
-// place in a user-supplied buffer of length > 36
+// convert 64-bit unsigned quantity to string
+// place in a user-supplied buffer of length > 72
 
-void bitsString(Bits val, char *buf)
+void bitsString(HashBits val, char *buf)
 {
 	int i,j; char ch;
-	Bits bit = 0x80000000;
+	HashBits bit = (HashBits)1 << (MAXBITS-1);
 
 	i = j = 0;
 	while (bit != 0) {
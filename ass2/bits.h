@@ -6,12 +6,15 @@
 #ifndef BITS_H
 #define BITS_H 1
 
+// hash of one attribute value (HASHBITS bits)
 typedef unsigned int Bits;
+// composite hash of a tuple, from its choice vector (MAXBITS bits)
+typedef unsigned long long HashBits;
 
-int bitIsSet(Bits, int);
-Bits setBit(Bits, int);
-Bits unsetBit(Bits, int);
-Bits getLower(Bits, int);
-void bitsString(Bits, char *);
+int bitIsSet(HashBits, int);
+HashBits setBit(HashBits, int);
+HashBits unsetBit(HashBits, int);
+HashBits getLower(HashBits, int);
+void bitsString(HashBits, char *);
 
 #endif
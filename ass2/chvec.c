@@ -11,21 +11,25 @@
 
 // convert a a,b:a,b:a,b:...:a,b" representation
 //  of a choice vector into a ChVec
-// if string doesn't specify all 32 bits, then
-//  cycle through attributes until reach 32 bits
+// if string doesn't specify all MAXCHVEC bits, then
+//  cycle through attributes until reach MAXCHVEC bits
 
 Status parseChVec(Reln r, char *str, ChVec cv)
 {
 	Count i = 0, nattr = nattrs(r);
 	char *c = str, *c0 = str;
 	while (*c != '\0') {
+		if (i == MAXCHVEC) {
+			printf("Choice vector has more than %d elements\n", MAXCHVEC);
+			return ~OK;
+		}
 		while (*c != ':' && *c != '\0') c++;
 		Count a, b, n;
 		if (*c == '\0') {
 			n = sscanf(c0, "%d,%d", &a, &b);
 			// is the (attr,bit) pair valid?
 			// neither a nor b can be < 0 because they're unsigned
-			if (n != 2 || a >= nattr || b >= 32) {
+			if (n != 2 || a >= nattr || b >= HASHBITS) {
 				printf("Invalid choice vector element: (att:%d,bit:%d)\n",a,b);
 				return ~OK;
 			}
@@ -33,7 +37,7 @@ Status parseChVec(Reln r, char *str, ChVec cv)
 		else {
 			*c = '\0';
 			n = sscanf(c0, "%d,%d", &a, &b);
-			if (n != 2 || a >= nattr || b >= 32) {
+			if (n != 2 || a >= nattr || b >= HASHBITS) {
 				printf("Invalid choice vector element: (att:%d,bit:%d)\n",a,b);
                 return ~OK;
             }
@@ -43,19 +47,43 @@ Status parseChVec(Reln r, char *str, ChVec cv)
 		printf("cv[%d] is (%d,%d)\n", i, cv[i].att, cv[i].bit);
 		i++;
 	}
-	// get enough bits for a 32-bit choice vector
-	// take new bits from top end of each hash,
-	//   so as to hopefully not conflict 
-	Count x;  Count next[MAXCHVEC];
-	for (x = 0; x < MAXCHVEC; x++) next[x] = 31;
+	Count from = i;
+	extendChVec(cv, from, nattr);
+	for (i = from; i < MAXCHVEC; i++)
+		printf("cv[%d] is (%d,%d)\n", i, cv[i].att, cv[i].bit);
+	return OK;
+}
+
+// fill cv[from..MAXCHVEC-1], cycling through the attributes
+// take new bits from top end of each hash,
+//   so as to hopefully not conflict with the low bits
+//   usually given explicitly; bits already in cv[0..from-1]
+//   are skipped, and an attribute whose bits are all used
+//   gives its turn to the next one
+
+void extendChVec(ChVec cv, Count from, Count nattr)
+{
+	Bits used[MAXATTRS];
+	int next[MAXATTRS];
+	Count x, i;
+	for (x = 0; x < nattr; x++) { used[x] = 0; next[x] = HASHBITS-1; }
+	for (i = 0; i < from; i++) used[cv[i].att] |= (Bits)1 << cv[i].bit;
 	x = 0;
-	while (i < MAXCHVEC) {
+	for (i = from; i < MAXCHVEC; i++) {
+		Count tries = 0;
+		for (;;) {
+			while (next[x] >= 0 && (used[x] & ((Bits)1 << next[x])))
+				next[x]--;
+			if (next[x] >= 0 || ++tries > nattr) break;
+			x = (x+1) % nattr;
+		}
+		// only if nattr*HASHBITS < MAXCHVEC; reuse a bit
+		if (next[x] < 0) next[x] = HASHBITS-1;
 		cv[i].att = x; cv[i].bit = next[x];
-		printf("cv[%d] is (%d,%d)\n", i, cv[i].att, cv[i].bit);
+		used[x] |= (Bits)1 << next[x];
 		next[x]--;
-		i++; x = (x+1) % nattr;
+		x = (x+1) % nattr;
 	}
-	return OK;
 }
 
 // print a choice vector (for debugging)
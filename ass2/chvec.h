@@ -11,13 +11,14 @@
 #include "defs.h"
 #include "reln.h"
 
-#define MAXCHVEC 32
+#define MAXCHVEC MAXBITS
 
 typedef struct _ChVecItem { Byte att; Byte bit; } ChVecItem;
 
 typedef ChVecItem ChVec[MAXCHVEC];
 
 Status parseChVec(Reln r, char *str, ChVec cv);
+void extendChVec(ChVec cv, Count from, Count nattr);
 void printChVec(ChVec cv);
 
 #endif
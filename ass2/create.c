@@ -1,8 +1,17 @@
 // create.c ... create an empty Relation
 // part of Multi-attribute linear-hashed files
 // Ask a query on a named file
-// Usage:  ./create  [-v]  RelName  #attrs  #pages  ChoiceVector
-// where #attrs = # of attributes in each tuple
+// Usage:  ./create  [-v]  [-p]  [-s a]  [-e scheme]  [-k K  [-d dir,...]]
+//                   RelName  #attrs  #pages  ChoiceVector
+// where -p = store tuples in PAX (attribute minipage) layout
+//	   -s a = keep each bucket sorted on attribute a (not with -p)
+//	   -e scheme = how the file grows: linear (default), spiral
+//	               or extendible
+//	   -k K = split the relation into 2^K partitions, each
+//	          a relation of its own, listed in RelName.parts
+//	   -d dir,... = put the partitions in these directories,
+//	          in turn (default: alongside RelName)
+//	   #attrs = # of attributes in each tuple
 //	   #pages = initial (empty) pages in File
 //	   ChoiceVector = attr,bit:attr,bit:...
 
@@ -11,8 +20,10 @@
 #include <string.h>
 #include "util.h"
 #include "reln.h"
+#include "page.h"
+#include "part.h"
 
-#define USAGE "./create  [-v]  RelName  #attrs  #pages  ChoiceVector"
+#define USAGE "./create  [-v]  [-p]  [-s a]  [-e scheme]  [-k K  [-d dir,...]]  RelName  #attrs  #pages  ChoiceVector"
 
 
 // Main ... process args, create relation
@@ -24,6 +35,11 @@ int main(int argc, char **argv)
 	int npages;  // initial number of pages
 	char err[MAXERRMSG];  // buffer for error messages
 	int verbose;  // show extra info on query progress
+	int pagelayout;  // how tuples are laid out in pages
+	int sortatt;  // attribute buckets are sorted on (-1 = none)
+	int scheme;   // how the file grows
+	int pbits;    // partition bits (0 = not partitioned)
+	char *dirs;   // directories for partitions (NULL = none given)
 	char *rname;  // name of table/file
 	char *attrs;   // number of attributes in tuples
 	char *pages;   // number of pages in data file
@@ -32,19 +48,48 @@ int main(int argc, char **argv)
 	// Process command-line args
 
 	if (argc < 2) fatal(USAGE);
-	if (strcmp(argv[1], "-v") == 0) {
-		if (argc < 6) fatal(USAGE);
-	    verbose = 1; rname = argv[2]; attrs = argv[3]; pages = argv[4]; cv = argv[5];
-	}
-	else {
-		if (argc < 5) fatal(USAGE);
-	    verbose = 0; rname = argv[1]; attrs = argv[2]; pages = argv[3]; cv = argv[4];
+	verbose = 0; pagelayout = ROW_LAYOUT; sortatt = -1; scheme = LINEAR_HASH;
+	pbits = 0; dirs = NULL;
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[arg], "-p") == 0)
+			pagelayout = PAX_LAYOUT;
+		else if (strcmp(argv[arg], "-s") == 0 && arg+1 < argc)
+			sortatt = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-e") == 0 && arg+1 < argc) {
+			arg++;
+			if (strcmp(argv[arg], "linear") == 0)
+				scheme = LINEAR_HASH;
+			else if (strcmp(argv[arg], "spiral") == 0)
+				scheme = SPIRAL_HASH;
+			else if (strcmp(argv[arg], "extendible") == 0)
+				scheme = EXTENDIBLE_HASH;
+			else
+				fatal(USAGE);
+		}
+		else if (strcmp(argv[arg], "-k") == 0 && arg+1 < argc) {
+			pbits = atoi(argv[++arg]);
+			if (pbits < 1 || pbits > MAXPARTBITS) {
+				sprintf(err, "Invalid #partition bits: %d (must be 0 < K <= %d)",
+				        pbits, MAXPARTBITS);
+				fatal(err);
+			}
+		}
+		else if (strcmp(argv[arg], "-d") == 0 && arg+1 < argc)
+			dirs = argv[++arg];
+		else
+			fatal(USAGE);
+		arg++;
 	}
+	if (argc - arg < 4) fatal(USAGE);
+	rname = argv[arg]; attrs = argv[arg+1]; pages = argv[arg+2]; cv = argv[arg+3];
 
 	// how many attributes in each tuple
 	nattrs = atoi(attrs);
-	if (nattrs < 2 || nattrs > 10) {
-		sprintf(err, "Invalid #attrs: %d (must be 1 < # < 11)", nattrs);
+	if (nattrs < 1 || nattrs > MAXATTRS) {
+		sprintf(err, "Invalid #attrs: %d (must be 0 < # <= %d)", nattrs, MAXATTRS);
 		fatal(err);
 	}
 
@@ -64,11 +109,24 @@ int main(int argc, char **argv)
 
 	// Open files for the Relation and initialise
 
-	if (existsRelation(rname)) {
+	if (dirs != NULL && pbits == 0) fatal(USAGE);
+	if (existsRelation(rname) || isPartitioned(rname)) {
 		sprintf(err, "Relation %s already exists", rname);
 		fatal(err);
 	}
-	if (newRelation(rname, nattrs, np, d, cv) != OK) {
+	if (sortatt < -1 || sortatt >= nattrs
+	    || (sortatt >= 0 && pagelayout == PAX_LAYOUT)) {
+		sprintf(err, "Invalid sort attribute: %d", sortatt);
+		fatal(err);
+	}
+	if (pbits > 0) {
+		if (newParts(rname, pbits, dirs, nattrs, np, d, cv,
+		             pagelayout, sortatt, scheme) != OK) {
+			sprintf(err, "Problems while creating partitions of %s", rname);
+			fatal(err);
+		}
+	}
+	else if (newRelation(rname, nattrs, np, d, cv, pagelayout, sortatt, scheme) != OK) {
 		sprintf(err, "Problems while creating relation %s", rname);
 		fatal(err);
 	}
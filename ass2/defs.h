@@ -15,10 +15,15 @@
 #define PAGESIZE    1024
 #define NO_PAGE     0xffffffff
 #define MAXERRMSG   200
-#define MAXTUPLEN   200
+#define MAXTUPLEN   PAGESIZE  // longest tuple kept in a page; longer
+                              //   ones have values moved to rel.lob
+#ifndef MAXATTRS
+#define MAXATTRS    32        // (make MAXATTRS=n to change; n < 256)
+#endif
 #define MAXRELNAME  200
 #define MAXFILENAME MAXRELNAME+8
-#define MAXBITS     32
+#define MAXBITS     64   // bits in a tuple's composite hash
+#define HASHBITS    32   // bits in an attribute value's hash
 #define OK          0
 #define TRUE        1
 #define FALSE       0
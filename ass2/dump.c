@@ -1,14 +1,18 @@
 // dump.c ... show all tuples in a Relation
 // part of Multi-attribute linear-hashed files
-// Show tuples, bucket-by-bucket
+// Show tuples, bucket-by-bucket (partition-by-partition for
+//   a partitioned relation)
 // Last modified by John Shepherd, July 2019
 // Usage:  ./stats  RelName
 
 #include "defs.h"
 #include "reln.h"
 #include "page.h"
+#include "lob.h"
+#include "part.h"
 
-void showAllTuples(Page);
+void showAllBuckets(Reln);
+void showAllTuples(Reln, Page);
 
 #define USAGE "./dump  RelName"
 
@@ -23,42 +27,54 @@ int main(int argc, char **argv)
 
 	// open relation and show stats
 
+	if (isPartitioned(relname)) {
+		Parts parts = openParts(relname,"r");
+		if (parts == NULL)
+			fatal("Can't open partitions of relation");
+		for (Count i = 0; i < nparts(parts); i++) {
+			printf("Partition[%d] %s\n", i, partName(parts, i));
+			showAllBuckets(partReln(parts, i));
+		}
+		closeParts(parts);
+		return 0;
+	}
 	if (!existsRelation(relname))
 		fatal("No such relation");
 	Reln r = openRelation(relname,"r");
 	if (r == NULL)
 		fatal("Can't open relation");
+	showAllBuckets(r);
+	closeRelation(r);
+
+	return 0;
+}
 
+// scan all buckets in Relation
+
+void showAllBuckets(Reln r)
+{
 	for (Offset pid = 0; pid < npages(r); pid++) {
 		printf("Bucket[%d]\n",pid);
-		// show tuples in data file
-		Page pg = getPage(dataFile(r),pid);
-		showAllTuples(pg);
-		// show tuples in overflow pages
-		Page ovpg;  PageID ovp;
-		ovp = pageOvflow(pg);
-		while (ovp != NO_PAGE) {
+		// show tuples in primary page, then overflow pages
+		Page pg = firstBucketPage(r, pid);
+		showAllTuples(r, pg);
+		while ((pg = nextBucketPage(r, pg)) != NULL) {
 			printf("Ovflow->\n");
-			ovpg = getPage(ovflowFile(r), ovp);
-			showAllTuples(ovpg);
-			ovp = pageOvflow(ovpg);
-			free(ovpg);
+			showAllTuples(r, pg);
 		}
-		free(pg);
 	}
-	closeRelation(r);
-
-	return 0;
 }
 
 // scan all tuples in Page
 
-void showAllTuples(Page pg)
+void showAllTuples(Reln r, Page pg)
 {
-		Count ntups = pageNTuples(pg);
-		char *c = pageData(pg);
-		for (int i = 0; i < ntups; i++) {
-			printf("%s\n", c);
-			c += strlen(c) + 1;
-		}
+		char *buf = NULL;  // for tuples with values in rel.lob
+		int size = 0;
+		PageScan scan;
+		Tuple t;
+		startPageScan(&scan, pg, nattrs(r), layout(r));
+		while ((t = nextPageTuple(&scan)) != NULL)
+			printf("%s\n", lobResolve(lobFile(r), t, &buf, &size));
+		free(buf);
 }
@@ -0,0 +1,79 @@
+// freeze.c ... make a relation read-only and read-optimised
+// part of Multi-attribute linear-hashed files
+// Rewrites a relation so that each bucket is one contiguous extent
+// Usage:  ./freeze  [-v]  RelName
+// -v shows page counts before and after
+// Each partition of a partitioned relation is frozen in turn
+
+#include "defs.h"
+#include "reln.h"
+#include "part.h"
+
+#define USAGE "./freeze  [-v]  RelName"
+
+// total pages over all buckets
+
+static Count totalPages(char *rname)
+{
+	Reln r = openRelation(rname,"r");
+	if (r == NULL) fatal("Can't open relation");
+	BucketStats *bs = bucketStats(r);
+	Count n = 0;
+	for (PageID b = 0; b < npages(r); b++) n += bs[b].npages;
+	closeRelation(r);
+	return n;
+}
+
+// freeze one relation
+
+static void freeze(char *rname, int verbose)
+{
+	char err[MAXERRMSG];
+	Count before = verbose ? totalPages(rname) : 0;
+	if (freezeRelation(rname) != OK) {
+		sprintf(err, "Can't freeze relation: %s",rname);
+		fatal(err);
+	}
+	if (verbose)
+		printf("%s: %d pages before, %d after\n",
+		       rname, before, totalPages(rname));
+}
+
+// Main ... process args, freeze relation
+
+int main(int argc, char **argv)
+{
+	int verbose = 0;
+	int arg = 1;
+	if (arg < argc && strcmp(argv[arg], "-v") == 0) {
+		verbose = 1;
+		arg++;
+	}
+	if (arg >= argc) fatal(USAGE);
+	char *rname = argv[arg];
+	char err[MAXERRMSG];
+
+	if (isPartitioned(rname)) {
+		// (the partitions are rewritten, so not kept open)
+		Parts parts = openParts(rname,"r");
+		if (parts == NULL) fatal("Can't open partitions of relation");
+		Count n = nparts(parts);
+		char **names = malloc(n*sizeof(char *));
+		assert(names != NULL);
+		for (Count i = 0; i < n; i++)
+			names[i] = copyString(partName(parts, i));
+		closeParts(parts);
+		for (Count i = 0; i < n; i++) {
+			freeze(names[i], verbose);
+			free(names[i]);
+		}
+		free(names);
+		return 0;
+	}
+	if (!existsRelation(rname)) {
+		sprintf(err, "No such relation: %s",rname);
+		fatal(err);
+	}
+	freeze(rname, verbose);
+	return 0;
+}
@@ -1,66 +1,624 @@
 // gendata.c ... generate random tuples
 // part of Multi-attribute linear-hashed files
 // Generates a list of K random tuples with N attributes
-// Usage:  ./insert  [-v]  #attributes  #tuples
+// Usage:  ./gendata  [-l len]  [-A spec]...  [-t threads]
+//                    [-q File  [-Q n]  [-S shape:weight]...]
+//                    #tuples  #attributes  [startID]  [seed]
+// -l len pads each tuple out to len chars, by lengthening its
+//   last value (so that tuple sizes can be varied)
+// -A a:dist[:key=val]... says how attribute a's values are drawn
+//   dist is one of
+//     uniform  every value equally likely
+//     zipf     the i'th commonest value has frequency ~ 1/i^s (s=1)
+//     hot      a fraction p (0.9) of the tuples take their value
+//              from the first hot (0.1) of the values
+//     corr     usually (but for a fraction noise (0.1) of tuples)
+//              the same value number as earlier attribute with=b
+//   and every dist takes card=n (number of values, default 251)
+//   and len=min[-max] (values are padded out to between min and
+//   max chars; each value always has the same length)
+// -t threads generates in parallel; the output is the same for any
+//   number of threads
+// -q File also writes a query workload to File: -Q n queries
+//   (default 1000), of shapes (strings of k = known, ? = unknown,
+//   one per attribute) chosen in proportion to their weights
+//   (default: all known 20, one known 70 spread over the
+//   attributes, none known 1), each made from the values of a
+//   randomly chosen tuple, so that every query finds some tuple
+// Attribute 0 is a sequential id unless -A gives it a dist
+// Without -A, -t or -q, the tuples are exactly as they always were
+//   (values from the word list, chosen by rand()); with any of
+//   them, each value is a word with its value number appended
 // Last modified by John Shepherd, July 2019
 
+#include <pthread.h>
+#include <math.h>
 #include "defs.h"
 
-#define USAGE "./insert  #tuples  #attributes  [startID]  [seed]"
+#define USAGE "./gendata  [-l len]  [-A spec]...  [-t threads]  [-q File  [-Q n]  [-S shape:weight]...]\n" \
+              "           #tuples  #attributes  [startID]  [seed]"
+#define NWORDS 251
+#define MAXTHREADS 64
+#define BLOCKSIZE 16384   // tuples generated from one random stream
+#define MAXSHAPES 64
 
-// Main ... process args, read/insert tuples
+extern char *words[NWORDS];
+
+// how an attribute's values are drawn
+#define SEQUENTIAL 0  // the tuple's id
+#define UNIFORM 1
+#define ZIPF 2
+#define HOTSET 3
+#define CORR 4
+
+typedef struct AttrGen {
+	int dist;        // one of the above
+	long long card;  // number of distinct values
+	double s;        // Zipf exponent
+	double hot, p;   // hot set: fraction of values, of tuples
+	int with;        // correlated with this (earlier) attribute
+	double noise;    // chance a correlated value is drawn uniformly
+	int minlen, maxlen;  // values are padded to minlen..maxlen chars
+	double hx1, hn, zs;  // Zipf sampler constants
+} AttrGen;
+
+// everything needed to generate tuples
+typedef struct Gen {
+	int natts;
+	AttrGen att[MAXATTRS];
+	long long startID;   // id of the first tuple
+	int len;             // pad tuples to this length
+	char *fill;          // padding is taken from random places here
+	unsigned long long seed;
+} Gen;
+
+// a block of generated tuples, for one thread
+typedef struct Block {
+	Gen *gen;
+	long long first, n;  // tuple numbers first..first+n-1
+	char *buf;           // the tuples, one per line
+	long size, used;
+} Block;
+
+// random numbers: each block of tuples has its own stream, seeded
+//   from the seed and the block number, so that blocks can be made
+//   in any order, by any thread
+
+// the stream for the block of tuples starting at tuple number first
+
+static unsigned long long blockStream(Gen *gen, long long first)
+{
+	unsigned long long rs = mix64(gen->seed ^ mix64(first/BLOCKSIZE));
+	return (rs == 0) ? 1 : rs;  // xorshift never leaves 0
+}
+
+// Zipf values by rejection-inversion (Hormann and Derflinger, 1996),
+//   which needs no table, so card can be as big as you like
+
+static double zipfH(double s, double x) { return exp(-s*log(x)); }
+
+static double helper1(double x)
+{
+	return fabs(x) > 1e-8 ? log1p(x)/x : 1 - x*(0.5 - x*(1/3.0 - 0.25*x));
+}
+
+static double helper2(double x)
+{
+	return fabs(x) > 1e-8 ? expm1(x)/x : 1 + x*0.5*(1 + x/3.0*(1 + 0.25*x));
+}
+
+static double zipfHIntegral(double s, double x)
+{
+	double logx = log(x);
+	return helper2((1-s)*logx)*logx;
+}
+
+static double zipfHIntegralInverse(double s, double x)
+{
+	double t = x*(1-s);
+	if (t < -1) t = -1;
+	return exp(helper1(t)*x);
+}
+
+static void zipfSetup(AttrGen *g)
+{
+	g->hx1 = zipfHIntegral(g->s, 1.5) - 1;
+	g->hn = zipfHIntegral(g->s, g->card + 0.5);
+	g->zs = 2 - zipfHIntegralInverse(g->s, zipfHIntegral(g->s, 2.5) - zipfH(g->s, 2));
+}
+
+// value number 0..card-1, 0 being the commonest
+
+static long long zipfNext(AttrGen *g, unsigned long long *rs)
+{
+	for (;;) {
+		double u = g->hn + nextUnit(rs)*(g->hx1 - g->hn);
+		double x = zipfHIntegralInverse(g->s, u);
+		long long k = (long long)(x + 0.5);
+		if (k < 1) k = 1;
+		else if (k > g->card) k = g->card;
+		if (k - x <= g->zs || u >= zipfHIntegral(g->s, k + 0.5) - zipfH(g->s, k))
+			return k - 1;
+	}
+}
+
+// pick value numbers for all attributes of tuple number id
+
+static void pickValues(Gen *gen, long long id, unsigned long long *rs, long long *v)
+{
+	for (int a = 0; a < gen->natts; a++) {
+		AttrGen *g = &gen->att[a];
+		switch (g->dist) {
+		case SEQUENTIAL:
+			v[a] = id;
+			break;
+		case UNIFORM:
+			v[a] = nextRandom(rs) % g->card;
+			break;
+		case ZIPF:
+			v[a] = zipfNext(g, rs);
+			break;
+		case HOTSET: {
+			long long nhot = (long long)(g->hot*g->card + 0.5);
+			if (nhot < 1) nhot = 1;
+			if (nhot >= g->card || nextUnit(rs) < g->p)
+				v[a] = nextRandom(rs) % nhot;
+			else
+				v[a] = nhot + nextRandom(rs) % (g->card - nhot);
+			break;
+		}
+		case CORR:
+			if (nextUnit(rs) < g->noise)
+				v[a] = nextRandom(rs) % g->card;
+			else
+				v[a] = v[g->with] % g->card;
+			break;
+		}
+	}
+}
+
+// write n in decimal at c; returns #chars
+
+static int putNum(char *c, unsigned long long n)
+{
+	char tmp[24];
+	int len = 0;
+	do { tmp[len++] = '0' + n % 10; n /= 10; } while (n > 0);
+	for (int i = 0; i < len; i++) c[i] = tmp[len-1-i];
+	return len;
+}
+
+// write value number k of attribute a at c; returns #chars
+// the same k always gives the same string
+
+static int putValue(Gen *gen, int a, long long k, char *c)
+{
+	AttrGen *g = &gen->att[a];
+	if (g->dist == SEQUENTIAL) return putNum(c, k);
+	char *c0 = c;
+	char *w = words[k % NWORDS];
+	while (*w != '\0') *c++ = *w++;
+	c += putNum(c, k);
+	if (g->maxlen > 0) {
+		unsigned long long h = mix64(k*MAXATTRS + a + 1);
+		int want = g->minlen + h % (g->maxlen - g->minlen + 1);
+		if (c - c0 < want) *c++ = '-';
+		while (c - c0 < want) {
+			*c++ = 'a' + h % 26;
+			h = mix64(h);
+		}
+	}
+	return c - c0;
+}
+
+// longest a tuple can be
+
+static long maxTuple(Gen *gen)
+{
+	long max = gen->len + 1;
+	for (int a = 0; a < gen->natts; a++)
+		max += 64 + gen->att[a].maxlen + 1;
+	return max;
+}
+
+// write tuple id, with value numbers v, at c; returns #chars
+// padding doesn't use the block's stream, so that a tuple's
+//   values depend only on the tuples before it in its block
+
+static int putTuple(Gen *gen, long long id, long long *v, char *c)
+{
+	char *t = c;
+	for (int a = 0; a < gen->natts; a++) {
+		if (a > 0) *c++ = ',';
+		c += putValue(gen, a, v[a], c);
+	}
+	int pad = gen->len - (c - t);
+	if (pad > 0) {
+		*c++ = '-';
+		memcpy(c, gen->fill + mix64(id) % gen->len, pad-1);
+		c += pad-1;
+	}
+	return c - t;
+}
+
+// generate a block of tuples into its buffer
+
+static void *genBlock(void *arg)
+{
+	Block *b = arg;
+	Gen *gen = b->gen;
+	long long v[MAXATTRS];
+	unsigned long long rs = blockStream(gen, b->first);
+	long max = maxTuple(gen);
+	if (b->size < b->n*max) {
+		b->size = b->n*max;
+		b->buf = realloc(b->buf, b->size);
+		assert(b->buf != NULL);
+	}
+	char *c = b->buf;
+	for (long long n = 0; n < b->n; n++) {
+		long long id = gen->startID + b->first + n;
+		pickValues(gen, id, &rs, v);
+		c += putTuple(gen, id, v, c);
+		*c++ = '\n';
+	}
+	b->used = c - b->buf;
+	return NULL;
+}
+
+// parse an attribute spec a:dist[:key=val]... into gen
+
+static Status parseSpec(Gen *gen, char *spec)
+{
+	char *s = copyString(spec);
+	char *f = strtok(s, ":");
+	int a = (f == NULL) ? -1 : atoi(f);
+	if (a < 0 || a >= gen->natts || (f = strtok(NULL, ":")) == NULL) {
+		free(s);
+		return -1;
+	}
+	AttrGen *g = &gen->att[a];
+	if (strcmp(f, "uniform") == 0) g->dist = UNIFORM;
+	else if (strcmp(f, "zipf") == 0) g->dist = ZIPF;
+	else if (strcmp(f, "hot") == 0) g->dist = HOTSET;
+	else if (strcmp(f, "corr") == 0) g->dist = CORR;
+	else { free(s); return -1; }
+	g->with = -1;
+	Status ok = OK;
+	while (ok == OK && (f = strtok(NULL, ":")) != NULL) {
+		char *val = strchr(f, '=');
+		if (val == NULL) { ok = -1; break; }
+		*val++ = '\0';
+		if (strcmp(f, "card") == 0) g->card = atoll(val);
+		else if (strcmp(f, "s") == 0) g->s = atof(val);
+		else if (strcmp(f, "hot") == 0) g->hot = atof(val);
+		else if (strcmp(f, "p") == 0) g->p = atof(val);
+		else if (strcmp(f, "with") == 0) g->with = atoi(val);
+		else if (strcmp(f, "noise") == 0) g->noise = atof(val);
+		else if (strcmp(f, "len") == 0) {
+			char *dash = strchr(val, '-');
+			g->minlen = atoi(val);
+			g->maxlen = (dash == NULL) ? g->minlen : atoi(dash+1);
+		}
+		else ok = -1;
+	}
+	free(s);
+	if (g->card < 1 || g->s <= 0 || g->hot <= 0 || g->hot > 1
+	    || g->p < 0 || g->p > 1 || g->noise < 0 || g->noise > 1
+	    || g->minlen < 0 || g->maxlen < g->minlen)
+		ok = -1;
+	if (g->dist == CORR && (g->with < 0 || g->with >= a))
+		ok = -1;
+	if (g->dist == ZIPF) zipfSetup(g);
+	return ok;
+}
+
+// a query shape, and how often it is used
+typedef struct Shape {
+	char pat[MAXATTRS+1];  // k = known, ? = unknown, per attribute
+	double weight;
+} Shape;
+
+// a query to be written: its shape, and the tuple it is made from
+typedef struct QuerySrc {
+	long i;          // position in the workload
+	int sh;          // shape
+	long long n;     // tuple number (0..ntups-1)
+	long long *v;    // the tuple's value numbers
+} QuerySrc;
+
+static int cmpTupleNum(const void *a, const void *b)
+{
+	const QuerySrc *q1 = a, *q2 = b;
+	return q1->n < q2->n ? -1 : q1->n > q2->n;
+}
+
+static int cmpQueryPos(const void *a, const void *b)
+{
+	const QuerySrc *q1 = a, *q2 = b;
+	return q1->i < q2->i ? -1 : q1->i > q2->i;
+}
+
+// write nq queries, with shapes chosen by weight, to out
+// each query's values are those of a tuple generated by genBlock(),
+//   so every query finds at least one tuple; the tuples are found
+//   by replaying their blocks' streams, in tuple number order
+
+static void genQueries(Gen *gen, long long ntups, Shape *shapes, int nshapes,
+                       long nq, FILE *out)
+{
+	double total = 0;
+	for (int i = 0; i < nshapes; i++) total += shapes[i].weight;
+	for (int i = 0; i < nshapes; i++)
+		fprintf(out, "# shape %s %.4f\n", shapes[i].pat, shapes[i].weight/total);
+	unsigned long long rs = mix64(~gen->seed);
+	if (rs == 0) rs = 1;
+	QuerySrc *qs = malloc(nq*sizeof(QuerySrc));
+	long long *vals = malloc(nq*gen->natts*sizeof(long long));
+	assert(qs != NULL && vals != NULL);
+	for (long i = 0; i < nq; i++) {
+		double x = nextUnit(&rs)*total;
+		int sh = 0;
+		while (sh < nshapes-1 && x >= shapes[sh].weight) x -= shapes[sh++].weight;
+		qs[i].i = i;
+		qs[i].sh = sh;
+		qs[i].n = nextRandom(&rs) % ntups;
+		qs[i].v = &vals[i*gen->natts];
+	}
+
+	// regenerate the chosen tuples' values
+	qsort(qs, nq, sizeof(QuerySrc), cmpTupleNum);
+	long long v[MAXATTRS];
+	long long next = -1;  // tuple number v is for
+	unsigned long long bs = 0;
+	for (long i = 0; i < nq; i++) {
+		long long n = qs[i].n;
+		if (next < 0 || n/BLOCKSIZE != next/BLOCKSIZE) {
+			// start of n's block
+			next = n - n % BLOCKSIZE;
+			bs = blockStream(gen, next);
+			pickValues(gen, gen->startID + next, &bs, v);
+		}
+		while (next < n) {
+			next++;
+			pickValues(gen, gen->startID + next, &bs, v);
+		}
+		memcpy(qs[i].v, v, gen->natts*sizeof(long long));
+	}
+	qsort(qs, nq, sizeof(QuerySrc), cmpQueryPos);
+
+	// known values are copied from the tuple (with any padding)
+	char *t = malloc(maxTuple(gen)), *q = malloc(maxTuple(gen));
+	assert(t != NULL && q != NULL);
+	for (long i = 0; i < nq; i++) {
+		t[putTuple(gen, gen->startID + qs[i].n, qs[i].v, t)] = '\0';
+		char *f = t, *c = q;
+		for (int a = 0; a < gen->natts; a++) {
+			int flen = strcspn(f, ",");
+			if (a > 0) *c++ = ',';
+			if (shapes[qs[i].sh].pat[a] == 'k') {
+				memcpy(c, f, flen);
+				c += flen;
+			}
+			else
+				*c++ = '?';
+			f += flen + 1;
+		}
+		*c++ = '\n';
+		fwrite(q, 1, c - q, out);
+	}
+	free(t);
+	free(q);
+	free(vals);
+	free(qs);
+}
+
+// Main ... process args, generate tuples
 
 int main(int argc, char **argv)
 {
 	int  natts;    // number of attributes in each tuple
-	int  ntups;    // number of tuples
-	int  startID;  // starting ID
+	long long ntups;    // number of tuples
+	long long startID;  // starting ID
+	int  len = 0;  // pad tuples to this length
 	char err[MAXERRMSG]; // buffer for error messages
+	char *specs[MAXATTRS*2];  // -A specs
+	int nspecs = 0;
+	int nthreads = 0;  // 0 = not given
+	char *qfile = NULL;  // where the query workload goes
+	long nq = 1000;      // queries in it
+	Shape shapes[MAXSHAPES];
+	int nshapes = 0;
 
 	// process command-line args
 
-	if (argc < 3) fatal(USAGE);
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-l") == 0 && arg+1 < argc)
+			len = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-A") == 0 && arg+1 < argc
+		         && nspecs < MAXATTRS*2)
+			specs[nspecs++] = argv[++arg];
+		else if (strcmp(argv[arg], "-t") == 0 && arg+1 < argc) {
+			nthreads = atoi(argv[++arg]);
+			if (nthreads < 1 || nthreads > MAXTHREADS) fatal(USAGE);
+		}
+		else if (strcmp(argv[arg], "-q") == 0 && arg+1 < argc)
+			qfile = argv[++arg];
+		else if (strcmp(argv[arg], "-Q") == 0 && arg+1 < argc) {
+			nq = atol(argv[++arg]);
+			if (nq < 1) fatal(USAGE);
+		}
+		else if (strcmp(argv[arg], "-S") == 0 && arg+1 < argc
+		         && nshapes < MAXSHAPES) {
+			char *sh = argv[++arg];
+			char *colon = strchr(sh, ':');
+			if (colon == NULL || colon - sh > MAXATTRS) fatal(USAGE);
+			memcpy(shapes[nshapes].pat, sh, colon - sh);
+			shapes[nshapes].pat[colon - sh] = '\0';
+			shapes[nshapes].weight = atof(colon+1);
+			if (shapes[nshapes].weight <= 0) fatal(USAGE);
+			nshapes++;
+		}
+		else
+			fatal(USAGE);
+		arg++;
+	}
+	if (argc - arg < 2 || len < 0) fatal(USAGE);
 
 	// how many tuples
-	ntups = atoi(argv[1]);
-	if (ntups < 1 || ntups > 100000) {
-		sprintf(err, "Invalid #tuples: %d (must be 0 < # < 10^6)", ntups);
+	ntups = atoll(argv[arg]);
+	if (ntups < 1) {
+		sprintf(err, "Invalid #tuples: %lld (must be 0 < #)", ntups);
 		fatal(err);
 	}
 
 	// how many attributes in each tuple
-	natts = atoi(argv[2]);
-	if (natts < 2 || natts > 10) {
-		sprintf(err, "Invalid #attrs: %d (must be 1 < # < 11)", natts);
+	natts = atoi(argv[arg+1]);
+	if (natts < 1 || natts > MAXATTRS) {
+		sprintf(err, "Invalid #attrs: %d (must be 0 < # <= %d)", natts, MAXATTRS);
 		fatal(err);
 	}
 
 	// set starting ID
-	if (argc < 4)
+	if (argc - arg < 3)
 		startID = 1;
 	else
-		startID = atoi(argv[3]);
+		startID = atoll(argv[arg+2]);
+
+	if (nspecs > 0 || nthreads > 0 || qfile != NULL) {
+		// the workload generator
+		Gen gen;
+		gen.natts = natts;
+		gen.startID = startID;
+		gen.len = len;
+		gen.seed = (argc - arg < 4) ? 0 : strtoull(argv[arg+3], NULL, 10);
+		for (int a = 0; a < natts; a++) {
+			AttrGen *g = &gen.att[a];
+			g->dist = (a == 0) ? SEQUENTIAL : UNIFORM;
+			g->card = NWORDS;
+			g->s = 1; g->hot = 0.1; g->p = 0.9;
+			g->with = -1; g->noise = 0.1;
+			g->minlen = g->maxlen = 0;
+		}
+		for (int i = 0; i < nspecs; i++) {
+			if (parseSpec(&gen, specs[i]) != OK) {
+				snprintf(err, MAXERRMSG, "Invalid attribute spec: %s", specs[i]);
+				fatal(err);
+			}
+		}
+		unsigned long long rs = mix64(gen.seed);
+		if (rs == 0) rs = 1;
+		gen.fill = malloc(2*len+1);
+		assert(gen.fill != NULL);
+		for (int i = 0; i < 2*len; i++) gen.fill[i] = 'a' + nextRandom(&rs)%26;
+
+		// blocks are made nthreads at a time, and written in order
+		if (nthreads < 1) nthreads = 1;
+		Block blocks[MAXTHREADS];
+		pthread_t tid[MAXTHREADS];
+		for (int i = 0; i < nthreads; i++) {
+			blocks[i].gen = &gen;
+			blocks[i].buf = NULL;
+			blocks[i].size = 0;
+		}
+		for (long long first = 0; first < ntups; ) {
+			int nb;
+			for (nb = 0; nb < nthreads && first < ntups; nb++) {
+				blocks[nb].first = first;
+				blocks[nb].n = (ntups - first < BLOCKSIZE) ? ntups - first : BLOCKSIZE;
+				first += blocks[nb].n;
+			}
+			if (nb == 1)
+				genBlock(&blocks[0]);
+			else {
+				// a block no thread can be started for is made here
+				Bool started[MAXTHREADS];
+				for (int i = 0; i < nb; i++) {
+					started[i] = pthread_create(&tid[i], NULL, genBlock, &blocks[i]) == 0;
+					if (!started[i]) genBlock(&blocks[i]);
+				}
+				for (int i = 0; i < nb; i++)
+					if (started[i]) pthread_join(tid[i], NULL);
+			}
+			for (int i = 0; i < nb; i++)
+				fwrite(blocks[i].buf, 1, blocks[i].used, stdout);
+		}
+		for (int i = 0; i < nthreads; i++) free(blocks[i].buf);
+
+		// and the query workload to go with them
+		if (qfile != NULL) {
+			if (nshapes == 0) {
+				// point queries, single-attribute queries, full scans
+				memset(shapes[0].pat, 'k', natts);
+				shapes[0].pat[natts] = '\0';
+				shapes[0].weight = 20;
+				nshapes = 1;
+				for (int a = 0; a < natts && natts > 1; a++) {
+					memset(shapes[nshapes].pat, '?', natts);
+					shapes[nshapes].pat[natts] = '\0';
+					shapes[nshapes].pat[a] = 'k';
+					shapes[nshapes].weight = 70.0/natts;
+					nshapes++;
+				}
+				memset(shapes[nshapes].pat, '?', natts);
+				shapes[nshapes].pat[natts] = '\0';
+				shapes[nshapes].weight = 1;
+				nshapes++;
+			}
+			for (int i = 0; i < nshapes; i++) {
+				if (strlen(shapes[i].pat) != natts
+				    || strspn(shapes[i].pat, "k?") != natts) {
+					snprintf(err, MAXERRMSG, "Invalid query shape: %s", shapes[i].pat);
+					fatal(err);
+				}
+			}
+			FILE *out = fopen(qfile, "w");
+			if (out == NULL) {
+				snprintf(err, MAXERRMSG, "Can't open %s", qfile);
+				fatal(err);
+			}
+			genQueries(&gen, ntups, shapes, nshapes, nq, out);
+			fclose(out);
+		}
+		free(gen.fill);
+		return OK;
+	}
 
 	// seed random # generator
-	if (argc < 5)
+	if (argc - arg < 4)
 		srand(0);
 	else
-		srand(atoi(argv[4]));
+		srand(atoi(argv[arg+3]));
+
+	// padding is taken from random places in a random string
+	char *fill = malloc(2*len+1);
+	assert(fill != NULL);
+	int i;
+	for (i = 0; i < 2*len; i++) fill[i] = 'a' + rand()%26;
 
 	// reflects distribution of letter usage in english ... somewhat
 	// id ensures that all tuples are distinct
-	int i, j, id=startID;
-	char attr[MAXTUPLEN];
-	char tuple[MAXTUPLEN];
+	long long n, id = startID;
+	int j;
+	char *tuple = malloc(32 + natts*16 + len + 1);
+	assert(tuple != NULL);
 	char *randWord();
-	for (i = 0; i < ntups; i++) {
-		sprintf(tuple,"%d",id++);
-		for (j = 0; j < natts-1; j++) {
-			sprintf(attr,",%s",randWord());
-			strcat(tuple,attr);
+	for (n = 0; n < ntups; n++) {
+		char *c = tuple + sprintf(tuple,"%lld",id++);
+		for (j = 0; j < natts-1; j++)
+			c += sprintf(c,",%s",randWord());
+		int pad = len - (c - tuple);
+		if (pad > 0) {
+			*c++ = '-';
+			memcpy(c, fill + rand()%len, pad-1);
+			c += pad-1;
 		}
-		printf("%s\n",tuple);
+		*c++ = '\n';
+		fwrite(tuple, 1, c - tuple, stdout);
 	}
+	free(tuple);
+	free(fill);
 
 	return OK;
 }
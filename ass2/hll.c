@@ -0,0 +1,48 @@
+// hll.c ... HyperLogLog distinct-count sketches
+// part of Multi-attribute Linear-hashed Files
+// A sketch is an array of HLLREGS one-byte registers
+// - the top HLLBITS bits of a 32-bit hash pick a register
+// - the register keeps the largest "rank" seen, where rank is
+//   the position of the first 1 bit in the remaining bits
+// - the estimate is the harmonic mean of 2^register, with the
+//   usual corrections for small and (32-bit) large counts
+// Standard error is about 1.04/sqrt(HLLREGS), i.e. ~3%
+
+#include <math.h>
+#include "defs.h"
+#include "hll.h"
+
+// add a hashed value to a sketch
+
+void hllAdd(Byte *regs, Bits hash)
+{
+	Bits reg = hash >> (HASHBITS - HLLBITS);
+	Bits rest = hash << HLLBITS;
+	Byte rank = 1;
+	while (rank <= HASHBITS - HLLBITS && (rest & 0x80000000) == 0) {
+		rank++;
+		rest <<= 1;
+	}
+	if (rank > regs[reg]) regs[reg] = rank;
+}
+
+// estimate #distinct values added to a sketch
+
+double hllEstimate(Byte *regs)
+{
+	double m = HLLREGS, sum = 0.0;
+	int i, zeros = 0;
+	for (i = 0; i < HLLREGS; i++) {
+		sum += ldexp(1.0, -regs[i]);
+		if (regs[i] == 0) zeros++;
+	}
+	double alpha = 0.7213/(1.0 + 1.079/m);
+	double est = alpha*m*m/sum;
+	if (est <= 2.5*m && zeros > 0)
+		// small range: linear counting over empty registers
+		est = m*log(m/zeros);
+	else if (est > 4294967296.0/30.0)
+		// large range: allow for collisions in 32-bit hashes
+		est = -4294967296.0*log(1.0 - est/4294967296.0);
+	return est;
+}
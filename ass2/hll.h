@@ -0,0 +1,17 @@
+// hll.h ... interface to HyperLogLog distinct-count sketches
+// part of Multi-attribute Linear-hashed Files
+// See hll.c for details of functions
+
+#ifndef HLL_H
+#define HLL_H 1
+
+#include "defs.h"
+#include "bits.h"
+
+#define HLLBITS 10               // hash bits that pick a register
+#define HLLREGS (1 << HLLBITS)   // registers (bytes) in a sketch
+
+void hllAdd(Byte *regs, Bits hash);
+double hllEstimate(Byte *regs);
+
+#endif
@@ -1,12 +1,15 @@
 // insert.c ... add tuples to a relation
 // part of Multi-attribute linear-hashed files
 // Reads tuples from stdin and inserts into Reln
+// Tuples for a partitioned relation go to the partition
+//   their hash picks
 // Usage:  ./insert  [-v]  RelName
 // Last modified by John Shepherd, July 2019
 
 #include "defs.h"
 #include "reln.h"
 #include "tuple.h"
+#include "part.h"
 
 #define USAGE "./insert  [-v]  RelName"
 
@@ -15,9 +18,9 @@
 int main(int argc, char **argv)
 {
 	Reln r;  // handle on the open relation
+	Parts parts;  // its partitions, if it is partitioned
 	Tuple t;  // tuple buffer
 	char err[2*MAXERRMSG];  // buffer for error messages
-	char tup[MAXTUPLEN];  // buffer for printable tuples
 	int verbose;  // show extra info on query progress
 	char *rname;  // name of table/file
 
@@ -32,11 +35,19 @@ int main(int argc, char **argv)
 
 	// set up relation for writing
 
-	if (!existsRelation(rname)) {
+	parts = NULL;
+	if (isPartitioned(rname)) {
+		if ((parts = openParts(rname,"r+")) == NULL) {
+			sprintf(err, "Can't open partitions of relation: %s",rname);
+			fatal(err);
+		}
+		r = partReln(parts, 0);
+	}
+	else if (!existsRelation(rname)) {
 		sprintf(err, "No such relation: %s", rname);
 		fatal(err);
 	}
-	if ((r = openRelation(rname,"r+")) == NULL) {
+	else if ((r = openRelation(rname,"r+")) == NULL) {
 		sprintf(err, "Can't open relation: %s",argv[1]);
 		fatal(err);
 	}
@@ -45,20 +56,30 @@ int main(int argc, char **argv)
 
 	while ((t = readTuple(r,stdin)) != NULL) {
 		PageID pid;
-		pid = addToRelation(r,t);
+		Count part = 0;
+		if (parts != NULL)
+			pid = addToParts(parts,t,&part);
+		else
+			pid = addToRelation(r,t);
 
-		tupleString(t,tup); // printable version
 		if (pid == NO_PAGE) {
-			sprintf(err, "Insert of %s failed\n", tup);
+			// (long tuples are cut short in the message)
+			sprintf(err, "Insert of %.*s failed\n", MAXERRMSG, t);
 			fatal(err);
 		}
-		if (verbose) printf("%s -> %d\n",tup,pid);
+		if (verbose && parts != NULL)
+			printf("%s -> %d:%d\n",t,part,pid);
+		else if (verbose)
+			printf("%s -> %d\n",t,pid);
 		free(t);
 	}
 
 	// clean up
 
-	closeRelation(r);
+	if (parts != NULL)
+		closeParts(parts);
+	else
+		closeRelation(r);
 
 	return 0;
 }
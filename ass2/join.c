@@ -0,0 +1,389 @@
+// join.c ... equi-joins between relations
+// part of Multi-attribute Linear-hashed Files
+// Joins r1 and r2 on r1.a1 = r2.a2, writing "t1,t2" for each pair
+
+#include "defs.h"
+#include "join.h"
+#include "reln.h"
+#include "page.h"
+#include "tuple.h"
+#include "query.h"
+#include "chvec.h"
+#include "hash.h"
+#include "bits.h"
+#include "lob.h"
+
+// Both joins build an in-memory hash table on the join values of
+//   the smaller relation's tuples, then probe it with the other's
+// - partitionJoin() relies on the first k choice vector entries
+//   of both relations taking the same bits of the join attribute;
+//   then matching tuples are in buckets with the same lower k
+//   address bits, and each group of such buckets is joined alone
+// - graceJoin() works for any relations, by first copying both
+//   into nparts temporary files on the hash of the join value
+// indexJoin() is for a small r1 and a large r2; it probes r2 with
+//   a partial-match query on r2.a2 for each r1 tuple, in batches
+//   sorted on bucket so that each bucket is read once per batch
+
+#define MAXPAIRS (1 << 20)   // max (bucket,probe) pairs per batch
+
+typedef struct JoinEntry {
+	struct JoinEntry *next;  // next entry in hash chain
+	Bits   hash;             // hash of join value
+	int    voff, vlen;       // join value is tup[voff..voff+vlen-1]
+	char   tup[1];           // copy of build tuple
+} JoinEntry;
+
+typedef struct JoinTable {
+	JoinEntry **slot;        // hash chains
+	Count  nslots;           // always a power of 2
+	Count  nentries;
+} JoinTable;
+
+// where output pairs go, and in which order
+typedef struct JoinOut {
+	FILE  *out;
+	Bool   buildFirst;       // build tuple is from r1
+	long   nout;             // #pairs written
+} JoinOut;
+
+static void buildTuple(JoinTable *t, Tuple tup, Count a);
+static void probeTuple(JoinTable *t, Tuple tup, Count a, JoinOut *jo);
+static void clearTable(JoinTable *t);
+
+// #low-order hash bits on which r1 and r2 are co-partitioned
+//   for a join on r1.a1 = r2.a2
+// only bits below both depths count, since every bucket's
+//   address uses at least that many bits
+// spiral relations don't place buckets by low-order bits
+
+Count coPartitionBits(Reln r1, Count a1, Reln r2, Count a2)
+{
+	ChVecItem *cv1 = chvec(r1), *cv2 = chvec(r2);
+	Count k = 0;
+	if (hashScheme(r1) != LINEAR_HASH || hashScheme(r2) != LINEAR_HASH)
+		return 0;
+	while (k < MAXCHVEC && cv1[k].att == a1 && cv2[k].att == a2
+	       && cv1[k].bit == cv2[k].bit)
+		k++;
+	if (k > depth(r1)) k = depth(r1);
+	if (k > depth(r2)) k = depth(r2);
+	return k;
+}
+
+// scan the tuples in bucket b, adding them to (build) the
+//   hash table, or probing it
+
+static void scanBucket(Reln r, PageID b, Count a, JoinTable *t, JoinOut *jo)
+{
+	char *lobbuf = NULL;  // for tuples with values in rel.lob
+	int lobsize = 0;
+	PageScan scan;
+	Tuple tup;
+	Page p;
+	for (p = firstBucketPage(r, b); p != NULL; p = nextBucketPage(r, p)) {
+		startPageScan(&scan, p, nattrs(r), layout(r));
+		while ((tup = nextPageTuple(&scan)) != NULL) {
+			tup = lobResolve(lobFile(r), tup, &lobbuf, &lobsize);
+			if (jo == NULL)
+				buildTuple(t, tup, a);
+			else
+				probeTuple(t, tup, a, jo);
+		}
+	}
+	free(lobbuf);
+}
+
+// join bucket-by-bucket, using the lower k bits of bucket addresses
+// returns number of pairs written
+
+long partitionJoin(Reln r1, Count a1, Reln r2, Count a2, Count k, FILE *out)
+{
+	JoinTable t = { NULL, 0, 0 };
+	JoinOut jo = { out, TRUE, 0 };
+	Reln br = r1, pr = r2;  Count ba = a1, pa = a2;
+	if (ntuples(r2) < ntuples(r1)) {
+		br = r2; pr = r1; ba = a2; pa = a1;
+		jo.buildFirst = FALSE;
+	}
+	PageID v, b, step = 1 << k;
+	for (v = 0; v < step; v++) {
+		for (b = v; b < npages(br); b += step)
+			scanBucket(br, b, ba, &t, NULL);
+		if (t.nentries > 0) {
+			for (b = v; b < npages(pr); b += step)
+				scanBucket(pr, b, pa, &t, &jo);
+		}
+		clearTable(&t);
+	}
+	free(t.slot);
+	return jo.nout;
+}
+
+// copy every tuple of r to one of nparts files, on its join value
+
+static void partitionReln(Reln r, Count a, Count nparts, FILE **part)
+{
+	char *lobbuf = NULL;  // for tuples with values in rel.lob
+	int lobsize = 0;
+	PageScan scan;
+	Tuple tup;
+	Page p;
+	PageID b;
+	for (b = 0; b < npages(r); b++) {
+		for (p = firstBucketPage(r, b); p != NULL; p = nextBucketPage(r, p)) {
+			startPageScan(&scan, p, nattrs(r), layout(r));
+			while ((tup = nextPageTuple(&scan)) != NULL) {
+				tup = lobResolve(lobFile(r), tup, &lobbuf, &lobsize);
+				int len;
+				char *v = tupleAttr(tup, a, &len);
+				Bits h = hash_any((unsigned char *)v, len);
+				fprintf(part[h % nparts], "%s\n", tup);
+			}
+		}
+	}
+	free(lobbuf);
+}
+
+// grace hash join through nparts pairs of temporary files
+// returns number of pairs written
+
+long graceJoin(Reln r1, Count a1, Reln r2, Count a2, Count nparts, FILE *out)
+{
+	JoinTable t = { NULL, 0, 0 };
+	JoinOut jo = { out, TRUE, 0 };
+	FILE **part1 = malloc(nparts*sizeof(FILE *));
+	FILE **part2 = malloc(nparts*sizeof(FILE *));
+	assert(part1 != NULL && part2 != NULL);
+	Count i;
+	for (i = 0; i < nparts; i++) {
+		part1[i] = tmpfile();
+		part2[i] = tmpfile();
+		if (part1[i] == NULL || part2[i] == NULL)
+			fatal("Can't create join partition file");
+	}
+	partitionReln(r1, a1, nparts, part1);
+	partitionReln(r2, a2, nparts, part2);
+
+	FILE **bpart = part1, **ppart = part2;
+	Count ba = a1, pa = a2;
+	if (ntuples(r2) < ntuples(r1)) {
+		bpart = part2; ppart = part1; ba = a2; pa = a1;
+		jo.buildFirst = FALSE;
+	}
+	char *line = NULL;
+	int size = 0;
+	for (i = 0; i < nparts; i++) {
+		rewind(bpart[i]);
+		while (readLine(bpart[i], &line, &size) != NULL)
+			buildTuple(&t, line, ba);
+		if (t.nentries > 0) {
+			rewind(ppart[i]);
+			while (readLine(ppart[i], &line, &size) != NULL)
+				probeTuple(&t, line, pa, &jo);
+		}
+		clearTable(&t);
+		fclose(part1[i]);
+		fclose(part2[i]);
+	}
+	free(t.slot);
+	free(line);
+	free(part1);
+	free(part2);
+	return jo.nout;
+}
+
+// a probe of one bucket of r2 by one r1 tuple
+typedef struct Probe { PageID bucket; Count tup; } Probe;
+
+// an index join's working space, reused for each batch
+typedef struct ProbeBufs {
+	Probe  *probes;          // (bucket,probe) pairs, maxprobes of them
+	Count   maxprobes;       // MAXPAIRS, or npages(r2) if that's more
+	PageID *cand;            // buckets of one probe, npages(r2) of them
+} ProbeBufs;
+
+static int cmpProbe(const void *a, const void *b)
+{
+	const Probe *p1 = a, *p2 = b;
+	if (p1->bucket != p2->bucket) return p1->bucket < p2->bucket ? -1 : 1;
+	return p1->tup < p2->tup ? -1 : p1->tup > p2->tup;
+}
+
+// scan each bucket of r2 in probes[0..nprobes-1] once, joining it
+//   with the r1 tuples that probe it
+
+static void runProbes(Reln r2, Count a2, Count a1, char **tups,
+                      Probe *probes, Count nprobes, JoinOut *jo)
+{
+	Count i, j;
+	qsort(probes, nprobes, sizeof(Probe), cmpProbe);
+	JoinTable t = { NULL, 0, 0 };
+	for (i = 0; i < nprobes; i = j) {
+		for (j = i; j < nprobes && probes[j].bucket == probes[i].bucket; j++)
+			buildTuple(&t, tups[probes[j].tup], a1);
+		scanBucket(r2, probes[i].bucket, a2, &t, jo);
+		clearTable(&t);
+	}
+	free(t.slot);
+}
+
+// probe r2 for a batch of r1 tuples
+// q is the probe query, with r2.a2 known and everything else "?"
+// how many buckets a probe touches depends on its value, so the
+//   pairs collected so far are run whenever the next probe's
+//   wouldn't fit
+
+static void probeBatch(Reln r2, Count a2, Query q, Count a1,
+                       char **tups, Count ntups, ProbeBufs *pb, JoinOut *jo)
+{
+	Probe *probes = pb->probes;
+	PageID *cand = pb->cand;
+	Count nprobes = 0, i, j;
+	for (j = 0; j < ntups; j++) {
+		int vlen;
+		char *v = tupleAttr(tups[j], a1, &vlen);
+		// "?" in r1 can't be a join value
+		char save = v[vlen];
+		v[vlen] = '\0';
+		Status ok = rebindQuery(q, a2, v);
+		v[vlen] = save;
+		if (ok != OK) continue;
+		Count nb = queryBuckets(q, cand, npages(r2));
+		if (nprobes + nb > pb->maxprobes) {
+			runProbes(r2, a2, a1, tups, probes, nprobes, jo);
+			nprobes = 0;
+		}
+		for (i = 0; i < nb; i++) {
+			probes[nprobes].bucket = cand[i];
+			probes[nprobes].tup = j;
+			nprobes++;
+		}
+	}
+	runProbes(r2, a2, a1, tups, probes, nprobes, jo);
+}
+
+// index nested-loop join, probing r2 for each r1 tuple
+// returns number of pairs written
+
+long indexJoin(Reln r1, Count a1, Reln r2, Count a2, Count batch, FILE *out)
+{
+	JoinOut jo = { out, TRUE, 0 };
+	// one query serves for every probe, rebound to each join value
+	char tmpl[2*MAXATTRS+2], *c = tmpl;
+	Count i;
+	for (i = 0; i < nattrs(r2); i++) {
+		if (i > 0) *c++ = ',';
+		*c++ = (i == a2) ? '0' : '?';
+	}
+	*c = '\0';
+	Query q = startQuery(r2, tmpl);
+	// keep (bucket,probe) pairs for a batch within bounds
+	ProbeBufs pb;
+	pb.maxprobes = (npages(r2) > MAXPAIRS) ? npages(r2) : MAXPAIRS;
+	pb.probes = malloc(pb.maxprobes*sizeof(Probe));
+	pb.cand = malloc(npages(r2)*sizeof(PageID));
+	assert(pb.probes != NULL && pb.cand != NULL);
+	Count per = queryBuckets(q, pb.cand, npages(r2));
+	if (batch*per > pb.maxprobes) batch = pb.maxprobes/per;
+	if (batch == 0) batch = 1;
+
+	char **tups = malloc(batch*sizeof(char *));
+	assert(tups != NULL);
+	Count n = 0;
+	char *lobbuf = NULL;  // for tuples with values in rel.lob
+	int lobsize = 0;
+	PageScan scan;
+	Tuple tup;
+	Page p;
+	PageID b;
+	for (b = 0; b < npages(r1); b++) {
+		for (p = firstBucketPage(r1, b); p != NULL; p = nextBucketPage(r1, p)) {
+			startPageScan(&scan, p, nattrs(r1), layout(r1));
+			while ((tup = nextPageTuple(&scan)) != NULL) {
+				tup = lobResolve(lobFile(r1), tup, &lobbuf, &lobsize);
+				tups[n++] = copyString(tup);
+				if (n < batch) continue;
+				probeBatch(r2, a2, q, a1, tups, n, &pb, &jo);
+				while (n > 0) free(tups[--n]);
+			}
+		}
+	}
+	probeBatch(r2, a2, q, a1, tups, n, &pb, &jo);
+	while (n > 0) free(tups[--n]);
+	free(tups);
+	free(lobbuf);
+	free(pb.probes);
+	free(pb.cand);
+	closeQuery(q);
+	return jo.nout;
+}
+
+// copy tuple into the hash table, on its value of attribute a
+
+static void buildTuple(JoinTable *t, Tuple tup, Count a)
+{
+	int tlen = strlen(tup), vlen;
+	JoinEntry *e = malloc(sizeof(JoinEntry) + tlen);
+	assert(e != NULL);
+	strcpy(e->tup, tup);
+	char *v = tupleAttr(e->tup, a, &vlen);
+	e->voff = v - e->tup;
+	e->vlen = vlen;
+	e->hash = hash_any((unsigned char *)v, vlen);
+	if (t->nentries >= 2*t->nslots) {
+		Count n = t->nslots == 0 ? 1024 : 2*t->nslots, s;
+		JoinEntry **slot = calloc(n, sizeof(JoinEntry *));
+		assert(slot != NULL);
+		for (s = 0; s < t->nslots; s++) {
+			JoinEntry *x, *next;
+			for (x = t->slot[s]; x != NULL; x = next) {
+				next = x->next;
+				x->next = slot[x->hash & (n-1)];
+				slot[x->hash & (n-1)] = x;
+			}
+		}
+		free(t->slot);
+		t->slot = slot;
+		t->nslots = n;
+	}
+	e->next = t->slot[e->hash & (t->nslots-1)];
+	t->slot[e->hash & (t->nslots-1)] = e;
+	t->nentries++;
+}
+
+// write out tup joined with each build tuple that matches it
+
+static void probeTuple(JoinTable *t, Tuple tup, Count a, JoinOut *jo)
+{
+	if (t->nentries == 0) return;
+	int vlen;
+	char *v = tupleAttr(tup, a, &vlen);
+	Bits h = hash_any((unsigned char *)v, vlen);
+	JoinEntry *e;
+	for (e = t->slot[h & (t->nslots-1)]; e != NULL; e = e->next) {
+		if (e->hash != h || e->vlen != vlen) continue;
+		if (memcmp(e->tup + e->voff, v, vlen) != 0) continue;
+		if (jo->buildFirst)
+			fprintf(jo->out, "%s,%s\n", e->tup, tup);
+		else
+			fprintf(jo->out, "%s,%s\n", tup, e->tup);
+		jo->nout++;
+	}
+}
+
+// release all entries, keeping the (empty) chains
+
+static void clearTable(JoinTable *t)
+{
+	Count s;
+	for (s = 0; s < t->nslots; s++) {
+		JoinEntry *e, *next;
+		for (e = t->slot[s]; e != NULL; e = next) {
+			next = e->next;
+			free(e);
+		}
+		t->slot[s] = NULL;
+	}
+	t->nentries = 0;
+}
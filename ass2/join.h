@@ -0,0 +1,16 @@
+// join.h ... interface to equi-joins between relations
+// part of Multi-attribute Linear-hashed Files
+// See join.c for details of functions
+
+#ifndef JOIN_H
+#define JOIN_H 1
+
+#include "defs.h"
+#include "reln.h"
+
+Count coPartitionBits(Reln r1, Count a1, Reln r2, Count a2);
+long partitionJoin(Reln r1, Count a1, Reln r2, Count a2, Count k, FILE *out);
+long graceJoin(Reln r1, Count a1, Reln r2, Count a2, Count nparts, FILE *out);
+long indexJoin(Reln r1, Count a1, Reln r2, Count a2, Count batch, FILE *out);
+
+#endif
@@ -0,0 +1,109 @@
+// joinrel.c ... equi-join two relations
+// part of Multi-attribute linear-hashed files
+// Joins R1 and R2 on R1.a1 = R2.a2, printing "t1,t2" for each pair
+// Usage:  ./joinrel  [-v]  [-g|-i]  R1  a1  R2  a2
+// where -g forces a grace hash join even if R1 and R2 are
+//   co-partitioned on the join attributes
+//       -i probes R2 with a partial-match query for each R1 tuple
+//          (index nested-loop join; best when R1 is small)
+//       -v reports the join method, pages read and throughput on stderr
+
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#include "defs.h"
+#include "reln.h"
+#include "join.h"
+#include "page.h"
+#include "part.h"
+
+#define USAGE "./joinrel  [-v]  [-g|-i]  R1  a1  R2  a2"
+#define NPARTS 64   // grace join partitions
+#define NPROBES 1024   // R1 tuples per batch of index probes
+
+// open a relation for reading, or die trying
+
+static Reln openInput(char *rname)
+{
+	char err[MAXERRMSG];
+	Reln r;
+	if (isPartitioned(rname)) {
+		sprintf(err, "Can't join partitioned relation %s; join its partitions",
+		        rname);
+		fatal(err);
+	}
+	if (!existsRelation(rname)) {
+		sprintf(err, "No such relation: %s",rname);
+		fatal(err);
+	}
+	if ((r = openRelation(rname,"r")) == NULL) {
+		sprintf(err, "Can't open relation: %s",rname);
+		fatal(err);
+	}
+	return r;
+}
+
+// Main ... process args, run join
+
+int main(int argc, char **argv)
+{
+	int verbose = 0;  // show method and timing
+	int grace = 0;    // always use grace hash join
+	int index = 0;    // use index nested-loop join
+
+	// process command-line args
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[arg], "-g") == 0)
+			grace = 1;
+		else if (strcmp(argv[arg], "-i") == 0)
+			index = 1;
+		else
+			fatal(USAGE);
+		arg++;
+	}
+	if (argc - arg < 4) fatal(USAGE);
+	Reln r1 = openInput(argv[arg]);
+	int a1 = atoi(argv[arg+1]);
+	Reln r2 = openInput(argv[arg+2]);
+	int a2 = atoi(argv[arg+3]);
+	if (a1 < 0 || a1 >= nattrs(r1) || a2 < 0 || a2 >= nattrs(r2))
+		fatal("Invalid join attribute");
+
+	// join bucket-by-bucket if possible, otherwise via partition files
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	Count k = (grace || index) ? 0 : coPartitionBits(r1, a1, r2, a2);
+	long n;
+	if (index)
+		n = indexJoin(r1, a1, r2, a2, NPROBES, stdout);
+	else if (k > 0)
+		n = partitionJoin(r1, a1, r2, a2, k, stdout);
+	else
+		n = graceJoin(r1, a1, r2, a2, NPARTS, stdout);
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (verbose) {
+		double secs = (end.tv_sec - start.tv_sec)
+		              + (end.tv_nsec - start.tv_nsec)/1e9;
+		long nin = (long)ntuples(r1) + ntuples(r2);
+		if (index)
+			fprintf(stderr, "index nested-loop join: ");
+		else if (k > 0)
+			fprintf(stderr, "partition-wise join on %d bits: ", k);
+		else
+			fprintf(stderr, "grace hash join, %d partitions: ", NPARTS);
+		fprintf(stderr, "%ld+%ld tuples in, %ld out, %d pages read, "
+		        "%.3fs (%.0f tuples/sec)\n",
+		        (long)ntuples(r1), (long)ntuples(r2), n, pagesRead(), secs,
+		        secs > 0 ? nin/secs : 0.0);
+	}
+
+	closeRelation(r1);
+	closeRelation(r2);
+	return 0;
+}
@@ -0,0 +1,105 @@
+// lob.c ... values stored outside their tuples
+// part of Multi-attribute Linear-hashed Files
+// A tuple too long for a page has its longest values moved to the
+//   relation's .lob file, which they are appended to
+// - in the tuple, each moved value is replaced by a reference:
+//   LOBREF, then the value's hash, length and offset in rel.lob,
+//   as 8, 8 and 16 hex digits
+// - the hash is kept so that tuples can be rehashed (when buckets
+//   split) and queries can rule out values without reading rel.lob
+// - space in rel.lob is never reused
+
+#include "defs.h"
+#include "lob.h"
+
+// is v[0..len-1] a reference to a value in rel.lob?
+
+Bool isLobRef(char *v, int len)
+{
+	return len == LOBREFLEN && v[0] == LOBREF;
+}
+
+// fields of a reference
+
+static unsigned long long refField(char *ref, int off, int len)
+{
+	char hex[17];
+	memcpy(hex, ref+off, len);
+	hex[len] = '\0';
+	return strtoull(hex, NULL, 16);
+}
+
+Bits lobRefHash(char *ref) { return refField(ref, 1, 8); }
+Count lobRefLength(char *ref) { return refField(ref, 9, 8); }
+
+// append value v (len chars, with hash) to the lob file
+// ref (LOBREFLEN+1 chars) is set to a reference to it
+
+void lobPut(FILE *lob, char *v, Count len, Bits hash, char *ref)
+{
+	int ok = fseek(lob, 0, SEEK_END);
+	assert(ok == 0);
+	long off = ftell(lob);
+	assert(off >= 0);
+	int n = fwrite(v, 1, len, lob);
+	assert(n == len);
+	sprintf(ref, "%c%08x%08x%016llx", LOBREF, hash, len,
+	        (unsigned long long)off);
+}
+
+// read the value that ref refers to into buf (of at least
+//   lobRefLength(ref)+1 chars), '\0'-terminated
+// returns buf
+
+char *lobGet(FILE *lob, char *ref, char *buf)
+{
+	Count len = lobRefLength(ref);
+	int ok = fseek(lob, (long)refField(ref, 17, 16), SEEK_SET);
+	assert(ok == 0);
+	int n = fread(buf, 1, len, lob);
+	assert(n == len);
+	buf[len] = '\0';
+	return buf;
+}
+
+// tuple t with each reference replaced by its value
+// returns t itself if it has no references, else the
+//   rebuilt tuple in *buf (of *size bytes), grown as needed
+
+char *lobResolve(FILE *lob, char *t, char **buf, int *size)
+{
+	if (lob == NULL || strchr(t, LOBREF) == NULL) return t;
+	// work out the length first
+	int len = 0;
+	char *c = t, *v;
+	for (;;) {
+		v = c;
+		while (*c != ',' && *c != '\0') c++;
+		len += isLobRef(v, c-v) ? lobRefLength(v) : c-v;
+		if (*c == '\0') break;
+		len++; c++;
+	}
+	if (*buf == NULL || *size < len+1) {
+		*size = len+1;
+		*buf = realloc(*buf, *size);
+		assert(*buf != NULL);
+	}
+	char *out = *buf;
+	c = t;
+	for (;;) {
+		v = c;
+		while (*c != ',' && *c != '\0') c++;
+		if (isLobRef(v, c-v)) {
+			lobGet(lob, v, out);
+			out += lobRefLength(v);
+		}
+		else {
+			memcpy(out, v, c-v);
+			out += c-v;
+		}
+		if (*c == '\0') break;
+		*out++ = *c++;
+	}
+	*out = '\0';
+	return *buf;
+}
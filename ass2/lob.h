@@ -0,0 +1,21 @@
+// lob.h ... interface to values stored outside their tuples
+// part of Multi-attribute Linear-hashed Files
+// See lob.c for details of functions
+
+#ifndef LOB_H
+#define LOB_H 1
+
+#include "defs.h"
+#include "bits.h"
+
+#define LOBREF    '\002'   // first char of a reference; never in input
+#define LOBREFLEN 33       // LOBREF + hash, length, offset (in hex)
+
+Bool isLobRef(char *v, int len);
+Bits lobRefHash(char *ref);
+Count lobRefLength(char *ref);
+void lobPut(FILE *lob, char *v, Count len, Bits hash, char *ref);
+char *lobGet(FILE *lob, char *ref, char *buf);
+char *lobResolve(FILE *lob, char *t, char **buf, int *size);
+
+#endif
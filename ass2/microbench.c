@@ -0,0 +1,287 @@
+// microbench.c ... time the innermost hashing, parsing and matching code
+// part of Multi-attribute linear-hashed files
+// Times each kernel on its own, over the tuples on stdin, using the
+//   choice vector of an existing relation
+// Usage:  ./microbench  [-k kernel]  [-n ops]  [-r runs]  [-w runs]
+//                       [-o File]  RelName  <  tuples
+// where -k kernel = time only this kernel (default all)
+//       -n ops = operations per timed run (default 200000)
+//       -r runs = timed runs per kernel (default 15)
+//       -w runs = untimed warmup runs per kernel (default 2)
+//       -o File = also write the results as JSON
+// Each kernel cycles through the tuples; the median and p99 over
+//   the runs of ns per operation are shown, with the bytes of
+//   input handled per second at the median
+// "make micro" runs this on tuples from ./gendata
+
+#include "defs.h"
+#include "reln.h"
+#include "tuple.h"
+#include "hash.h"
+#include "bits.h"
+
+#define USAGE "./microbench  [-k kernel]  [-n ops]  [-r runs]  [-w runs]  [-o File]  RelName  <  tuples"
+
+// the tuples, and things derived from them, that kernels work on
+typedef struct Bench {
+	Reln r;          // gives #attrs and choice vector
+	Count nattrs;
+	long ntups;
+	Tuple *tups;     // the tuples
+	int *tlen;       // their lengths
+	Tuple *qrys;     // a partial-match query made from each tuple
+	char **vals;     // every attribute value, ntups*nattrs of them
+	int *vlen;       // their lengths
+	HashBits *hash;  // each tuple's composite hash
+	volatile HashBits sink;  // kernel results go here, so that
+	                         //   none of their work is skipped
+} Bench;
+
+// a kernel does n operations, starting at the i'th input, and
+//   returns the bytes of input it handled
+typedef long (*Kernel)(Bench *b, long i, long n);
+
+// hash_any() on single attribute values
+
+static long kHashAny(Bench *b, long i, long n)
+{
+	long nvals = b->ntups*b->nattrs, bytes = 0;
+	for (long k = 0; k < n; k++, i++) {
+		if (i >= nvals) i = 0;
+		b->sink += hash_any((unsigned char *)b->vals[i], b->vlen[i]);
+		bytes += b->vlen[i];
+	}
+	return bytes;
+}
+
+// tupleHash() on whole tuples
+
+static long kTupleHash(Bench *b, long i, long n)
+{
+	long bytes = 0;
+	for (long k = 0; k < n; k++, i++) {
+		if (i >= b->ntups) i = 0;
+		b->sink += tupleHash(b->r, b->tups[i]);
+		bytes += b->tlen[i];
+	}
+	return bytes;
+}
+
+// tupleVals() (and freeVals()) on whole tuples
+
+static long kTupleVals(Bench *b, long i, long n)
+{
+	char **vals = malloc(b->nattrs*sizeof(char *));
+	assert(vals != NULL);
+	long bytes = 0;
+	for (long k = 0; k < n; k++, i++) {
+		if (i >= b->ntups) i = 0;
+		tupleVals(b->tups[i], vals);
+		b->sink += vals[0][0];
+		freeVals(vals, b->nattrs);
+		bytes += b->tlen[i];
+	}
+	free(vals);
+	return bytes;
+}
+
+// tupleMatch() of each tuple against the query made from the
+//   next one (so about as many misses as there are in a scan)
+
+static long kTupleMatch(Bench *b, long i, long n)
+{
+	long bytes = 0;
+	for (long k = 0; k < n; k++, i++) {
+		if (i >= b->ntups) i = 0;
+		long j = (i+1 < b->ntups) ? i+1 : 0;
+		b->sink += tupleMatch(b->r, b->tups[i], b->qrys[j]);
+		bytes += b->tlen[i];
+	}
+	return bytes;
+}
+
+// getLower() on composite hashes, for each depth a file might have
+
+static long kGetLower(Bench *b, long i, long n)
+{
+	for (long k = 0; k < n; k++, i++) {
+		if (i >= b->ntups) i = 0;
+		b->sink += getLower(b->hash[i], 1 + k % 24);
+	}
+	return n*sizeof(HashBits);
+}
+
+// bitIsSet() on each bit of composite hashes
+
+static long kBitIsSet(Bench *b, long i, long n)
+{
+	for (long k = 0; k < n; k++, i++) {
+		if (i >= b->ntups) i = 0;
+		b->sink += bitIsSet(b->hash[i], k % MAXBITS);
+	}
+	return n*sizeof(HashBits);
+}
+
+static struct { char *name; Kernel run; } kernels[] = {
+	{ "hash_any", kHashAny },
+	{ "tupleHash", kTupleHash },
+	{ "tupleVals", kTupleVals },
+	{ "tupleMatch", kTupleMatch },
+	{ "getLower", kGetLower },
+	{ "bitIsSet", kBitIsSet },
+};
+#define NKERNELS (sizeof(kernels)/sizeof(kernels[0]))
+
+// read the tuples, and work out what the kernels need from them
+
+static void loadBench(Bench *b, Reln r, FILE *in)
+{
+	b->r = r;
+	b->nattrs = nattrs(r);
+	b->ntups = 0;
+	b->sink = 0;
+	long max = 1024;
+	b->tups = malloc(max*sizeof(Tuple));
+	assert(b->tups != NULL);
+	Tuple t;
+	while ((t = readTuple(r, in)) != NULL) {
+		if (b->ntups == max) {
+			max *= 2;
+			b->tups = realloc(b->tups, max*sizeof(Tuple));
+			assert(b->tups != NULL);
+		}
+		b->tups[b->ntups++] = t;
+	}
+	if (b->ntups == 0) fatal("No tuples on stdin");
+
+	long n = b->ntups;
+	b->tlen = malloc(n*sizeof(int));
+	b->qrys = malloc(n*sizeof(Tuple));
+	b->vals = malloc(n*b->nattrs*sizeof(char *));
+	b->vlen = malloc(n*b->nattrs*sizeof(int));
+	b->hash = malloc(n*sizeof(HashBits));
+	assert(b->tlen != NULL && b->qrys != NULL && b->vals != NULL
+	       && b->vlen != NULL && b->hash != NULL);
+	for (long i = 0; i < n; i++) {
+		char **v = b->vals + i*b->nattrs;
+		b->tlen[i] = strlen(b->tups[i]);
+		tupleVals(b->tups[i], v);
+		// the query knows every other attribute, starting with
+		//   the first
+		b->qrys[i] = malloc(b->tlen[i] + b->nattrs + 1);
+		assert(b->qrys[i] != NULL);
+		char *c = b->qrys[i];
+		for (Count a = 0; a < b->nattrs; a++) {
+			b->vlen[i*b->nattrs + a] = strlen(v[a]);
+			if (a > 0) *c++ = ',';
+			c += sprintf(c, "%s", (a % 2 == 0) ? v[a] : "?");
+		}
+		b->hash[i] = tupleHash(r, b->tups[i]);
+	}
+}
+
+// Main ... process args, time each kernel
+
+int main(int argc, char **argv)
+{
+	char err[MAXERRMSG];  // buffer for error messages
+	char *only = NULL;    // the one kernel to time
+	long nops = 200000;   // operations per run
+	int nruns = 15, nwarm = 2;
+	FILE *json = NULL;    // where JSON results go
+
+	// process command-line args
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-k") == 0 && arg+1 < argc)
+			only = argv[++arg];
+		else if (strcmp(argv[arg], "-n") == 0 && arg+1 < argc)
+			nops = atol(argv[++arg]);
+		else if (strcmp(argv[arg], "-r") == 0 && arg+1 < argc)
+			nruns = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-w") == 0 && arg+1 < argc)
+			nwarm = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-o") == 0 && arg+1 < argc) {
+			if ((json = fopen(argv[++arg], "w")) == NULL)
+				fatal("Can't open output file");
+		}
+		else
+			fatal(USAGE);
+		arg++;
+	}
+	if (argc - arg < 1 || nops < 1 || nruns < 1 || nwarm < 0) fatal(USAGE);
+	char *rname = argv[arg];
+	int k;
+	for (k = 0; only != NULL && k < NKERNELS; k++) {
+		if (strcmp(only, kernels[k].name) == 0) break;
+	}
+	if (k == NKERNELS) {
+		sprintf(err, "No such kernel: %s", only);
+		fatal(err);
+	}
+
+	// the relation only supplies #attrs and the choice vector
+
+	if (!existsRelation(rname)) {
+		sprintf(err, "No such relation: %s",rname);
+		fatal(err);
+	}
+	Reln r = openRelation(rname,"r");
+	if (r == NULL) {
+		sprintf(err, "Can't open relation: %s",rname);
+		fatal(err);
+	}
+	Bench b;
+	loadBench(&b, r, stdin);
+
+	// time each kernel: warmup runs, then timed runs, each carrying
+	//   on through the tuples from where the last one stopped
+
+	double *nsop = malloc(nruns*sizeof(double));
+	assert(nsop != NULL);
+	printf("%ld tuples, %d attrs, %ld ops x %d runs\n",
+	       b.ntups, b.nattrs, nops, nruns);
+	printf("%-12s %10s %10s %12s\n", "kernel", "ns/op p50", "ns/op p99", "MB/s p50");
+	if (json != NULL)
+		fprintf(json, "{\n  \"tuples\": %ld, \"nattrs\": %d, \"ops\": %ld, "
+		        "\"runs\": %d,\n  \"kernels\": {", b.ntups, b.nattrs, nops, nruns);
+	int nshown = 0;
+	for (k = 0; k < NKERNELS; k++) {
+		if (only != NULL && strcmp(only, kernels[k].name) != 0) continue;
+		long i = 0, bytes = 0;
+		for (int w = 0; w < nwarm; w++) {
+			kernels[k].run(&b, i, nops);
+			i = (i + nops) % b.ntups;
+		}
+		for (int run = 0; run < nruns; run++) {
+			double start = now();
+			bytes = kernels[k].run(&b, i, nops);
+			nsop[run] = 1e9*(now() - start)/nops;
+			i = (i + nops) % b.ntups;
+		}
+		qsort(nsop, nruns, sizeof(double), cmpDouble);
+		double p50 = percentile(nsop, nruns, 0.5);
+		double p99 = percentile(nsop, nruns, 0.99);
+		// (runs differ only in where they start in the tuples, so
+		//   the last run's bytes stand for all of them)
+		double mbs = (double)bytes/nops/p50*1e9/1e6;
+		printf("%-12s %10.1f %10.1f %12.1f\n", kernels[k].name, p50, p99, mbs);
+		if (json != NULL)
+			fprintf(json, "%s\n    \"%s\": {\"ns_per_op_p50\": %.2f, "
+			        "\"ns_per_op_p99\": %.2f, \"mb_per_sec\": %.2f}",
+			        nshown > 0 ? "," : "", kernels[k].name, p50, p99, mbs);
+		nshown++;
+	}
+	if (json != NULL) {
+		fprintf(json, "\n  }\n}\n");
+		fclose(json);
+	}
+
+	// clean up
+
+	free(nsop);
+	closeRelation(r);
+
+	return 0;
+}
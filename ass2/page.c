@@ -21,6 +21,21 @@ struct PageRep {
 // - data[] is a sequence of bytes containing tuples
 // - each tuple is a sequence of chars terminated by '\0'
 // - PageID values count # pages from start of file
+//
+// Pages in a PAX_LAYOUT relation use data[] differently
+// - data[] starts with a directory of nattrs+1 minipage offsets
+// - minipage a holds attribute a of every tuple in the page,
+//   each value a sequence of chars terminated by '\0'
+// - the last directory entry marks the end of the last minipage,
+//   and always equals free
+// - minipages are kept contiguous, so adding a tuple shifts
+//   later minipages up to make room for each new value
+
+typedef unsigned short MiniOffset;
+
+// number of pages fetched by getPage(), for reporting I/O
+// (partitions may be scanned in parallel, so it is updated atomically)
+static Count nreads = 0;
 
 // create a new initially empty page in memory
 Page newPage()
@@ -41,7 +56,7 @@ PageID addPage(FILE *f)
 {
 	int ok = fseek(f, 0, SEEK_END);
 	assert(ok == 0);
-	int pos = ftell(f);
+	long pos = ftell(f);
 	assert(pos >= 0);
 	PageID pid = pos/PAGESIZE;
 	Page p = newPage();
@@ -56,10 +71,35 @@ Page getPage(FILE *f, PageID pid)
 	assert(pid >= 0);
 	Page p = malloc(PAGESIZE);
 	assert(p != NULL);
-	int ok = fseek(f, pid*PAGESIZE, SEEK_SET);
+	int ok = fseek(f, (long)pid*PAGESIZE, SEEK_SET);
 	assert(ok == 0);
 	int n = fread(p, 1, PAGESIZE, f);
 	assert(n == PAGESIZE);
+	__sync_fetch_and_add(&nreads, 1);
+	return p;
+}
+
+// fetch n consecutive Pages from a file with a single read
+// they share one buffer; use copyPage() to get a Page of its own
+Page getPages(FILE *f, PageID pid, Count n)
+{
+	assert(pid >= 0 && n > 0);
+	Page p = malloc(n*PAGESIZE);
+	assert(p != NULL);
+	int ok = fseek(f, (long)pid*PAGESIZE, SEEK_SET);
+	assert(ok == 0);
+	int got = fread(p, PAGESIZE, n, f);
+	assert(got == n);
+	__sync_fetch_and_add(&nreads, n);
+	return p;
+}
+
+// copy the i'th Page in a buffer from getPages()
+Page copyPage(Page ps, Count i)
+{
+	Page p = malloc(PAGESIZE);
+	assert(p != NULL);
+	memcpy(p, (char *)ps + i*PAGESIZE, PAGESIZE);
 	return p;
 }
 
@@ -67,7 +107,7 @@ Page getPage(FILE *f, PageID pid)
 Status putPage(FILE *f, PageID pid, Page p)
 {
 	assert(pid >= 0);
-	int ok = fseek(f, pid*PAGESIZE, SEEK_SET);
+	int ok = fseek(f, (long)pid*PAGESIZE, SEEK_SET);
 	assert(ok == 0);
 	int n = fwrite(p, 1, PAGESIZE, f);
 	assert(n == PAGESIZE);
@@ -92,6 +132,157 @@ Status addToPage(Page p, Tuple t)
 	return OK;
 }
 
+// insert a tuple into a page whose tuples are ordered on
+//   attribute a, after any tuples with the same value
+// returns 0 status if successful
+// returns -1 if not enough room
+Status addToSortedPage(Page p, Tuple t, Count a)
+{
+	int n = tupLength(t);
+	Count hdr_size = 2*sizeof(Offset) + sizeof(Count);
+	if (p->data+p->free+n > &p->data[PAGESIZE-hdr_size-2]) return -1;
+	int klen, len;
+	char *key = tupleAttr(t, a, &klen);
+	char *c = p->data, *end = p->data + p->free;
+	while (c < end) {
+		char *v = tupleAttr(c, a, &len);
+		if (compareVals(v, len, key, klen) > 0) break;
+		c += strlen(c) + 1;
+	}
+	memmove(c+n+1, c, end-c);
+	memcpy(c, t, n+1);
+	p->free += n+1;
+	p->ntuples++;
+	return OK;
+}
+
+// insert a tuple into a PAX page with nattrs attributes
+// returns 0 status if successful
+// returns -1 if not enough room
+Status addToPaxPage(Page p, Tuple t, Count nattrs)
+{
+	MiniOffset *mp = (MiniOffset *)p->data;
+	Count hdr_size = 2*sizeof(Offset) + sizeof(Count);
+	// first tuple in page; set up empty minipages
+	if (p->free == 0) {
+		Count a;
+		for (a = 0; a <= nattrs; a++) mp[a] = (nattrs+1)*sizeof(MiniOffset);
+		p->free = mp[nattrs];
+	}
+	// find start and length of each value in tuple
+	char *val[MAXATTRS]; Count len[MAXATTRS];
+	Count a = 0, total = 0;
+	char *c = t;
+	for (;;) {
+		val[a] = c;
+		while (*c != ',' && *c != '\0') c++;
+		len[a] = c - val[a];
+		total += len[a] + 1;
+		a++;
+		if (*c == '\0') break;
+		c++;
+	}
+	assert(a == nattrs);
+	// doesn't fit ... return fail code
+	if (p->free + total > PAGESIZE-hdr_size-2) return -1;
+	// shift minipages up, last one first, appending values as we go
+	// minipage a moves up by the total size of the values before it
+	Count shift = total;
+	for (a = nattrs; a-- > 0; ) {
+		shift -= len[a] + 1;
+		Count size = mp[a+1] - mp[a];
+		char *dest = p->data + mp[a] + shift;
+		memmove(dest, p->data + mp[a], size);
+		memcpy(dest + size, val[a], len[a]);
+		dest[size + len[a]] = '\0';
+	}
+	for (a = 1; a <= nattrs; a++) {
+		shift += len[a-1] + 1;
+		mp[a] += shift;
+	}
+	p->free = mp[nattrs];
+	p->ntuples++;
+	return OK;
+}
+
+// length of the longest tuple that an empty page can hold
+
+Count pageMaxTuple(Count nattrs, Count layout)
+{
+	Count hdr_size = 2*sizeof(Offset) + sizeof(Count);
+	Count max = PAGESIZE-hdr_size-2;
+	// PAX pages also hold the minipage directory
+	if (layout == PAX_LAYOUT) max -= (nattrs+1)*sizeof(MiniOffset) + 1;
+	return max;
+}
+
+// set up a scan over all tuples in a page
+
+void startPageScan(PageScan *s, Page p, Count nattrs, Count layout)
+{
+	s->page = p;
+	s->nattrs = nattrs;
+	s->layout = layout;
+	s->next = 0;
+	s->cur = p->data;
+	if (layout == PAX_LAYOUT && p->ntuples > 0) {
+		MiniOffset *mp = (MiniOffset *)p->data;
+		Count a;
+		for (a = 0; a < nattrs; a++) {
+			s->val[a] = p->data + mp[a];
+			s->at[a] = 0;
+		}
+	}
+}
+
+// return next tuple in the page, or NULL if no more
+// PAX tuples are reassembled in s->buf, and are only
+//   valid until the next call
+
+Tuple nextPageTuple(PageScan *s)
+{
+	if (s->next >= s->page->ntuples) return NULL;
+	if (s->layout == PAX_LAYOUT) return pageScanTuple(s, s->next++);
+	Tuple t = s->cur;
+	s->cur += strlen(t) + 1;
+	s->next++;
+	return t;
+}
+
+// return value of attribute a in the i'th tuple of a PAX page
+// only touches minipage a; requests for each attribute must
+//   have non-decreasing i
+
+char *pageScanValue(PageScan *s, Count i, Count a)
+{
+	assert(s->layout == PAX_LAYOUT && i < s->page->ntuples);
+	assert(i >= s->at[a]);
+	while (s->at[a] < i) {
+		s->val[a] += strlen(s->val[a]) + 1;
+		s->at[a]++;
+	}
+	return s->val[a];
+}
+
+// reassemble i'th tuple of a PAX page into s->buf
+
+Tuple pageScanTuple(PageScan *s, Count i)
+{
+	char *c = s->buf;
+	Count a;
+	for (a = 0; a < s->nattrs; a++) {
+		char *v = pageScanValue(s, i, a);
+		if (a > 0) *c++ = ',';
+		strcpy(c, v);
+		c += strlen(v);
+	}
+	return s->buf;
+}
+
+// number of pages fetched so far by this process
+
+Count pagesRead() { return nreads; }
+
 // extract page info
 char *pageData(Page p) { return p->data; }
 Count pageNTuples(Page p) { return p->ntuples; }
@@ -11,15 +11,41 @@ typedef struct PageRep *Page;
 #include "defs.h"
 #include "tuple.h"
 
+// how tuples are laid out inside data[]
+#define ROW_LAYOUT 0
+#define PAX_LAYOUT 1
+
+// cursor for scanning the tuples in a page of either layout
+typedef struct PageScanRep {
+	Page  page;            // page being scanned
+	Count nattrs;          // #attributes in each tuple
+	Count layout;          // ROW_LAYOUT or PAX_LAYOUT
+	Count next;            // index of next tuple to return
+	char *cur;             // ROW: next tuple in data[]
+	char *val[MAXATTRS];   // PAX: cursor into each minipage
+	Count at[MAXATTRS];    // PAX: index of tuple that val[a] refers to
+	char  buf[MAXTUPLEN];  // PAX: reassembled tuple
+} PageScan;
+
 Page newPage();
 PageID addPage(FILE *);
 Page getPage(FILE *, PageID);
+Page getPages(FILE *, PageID, Count);
+Page copyPage(Page, Count);
 Status putPage(FILE *, PageID, Page);
+Count pagesRead();
 Status addToPage(Page, Tuple);
+Status addToPaxPage(Page, Tuple, Count);
+Status addToSortedPage(Page, Tuple, Count);
+Count pageMaxTuple(Count, Count);
 char *pageData(Page);
 Count pageNTuples(Page);
 Offset pageOvflow(Page);
 void pageSetOvflow(Page, PageID);
 Count pageFreeSpace(Page);
+void startPageScan(PageScan *, Page, Count, Count);
+Tuple nextPageTuple(PageScan *);
+char *pageScanValue(PageScan *, Count, Count);
+Tuple pageScanTuple(PageScan *, Count);
 
 #endif
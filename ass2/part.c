@@ -0,0 +1,444 @@
+// part.c ... partitioned relations
+// part of Multi-attribute Linear-hashed Files
+// A partitioned relation R is 2^K ordinary relations (partitions),
+//   listed in the catalog file R.parts
+// - each partition has its own files, depth and split pointer,
+//   and can be given to any tool by name
+// - partitions can be put in different directories, so that
+//   their I/O is spread over several disks
+// - all partitions share R's choice vector, and a tuple goes to
+//   the partition given by K bits of its composite hash
+// - the hot segment bits are the top bits of the hash, so the K
+//   bits below them are used; each partition still has tuples
+//   with every value of the bits its buckets are chosen by
+// - a query only scans the partitions its known values allow,
+//   several at a time, each in a thread of its own
+
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <unistd.h>
+#include "defs.h"
+#include "part.h"
+#include "reln.h"
+#include "query.h"
+#include "tuple.h"
+#include "chvec.h"
+#include "hash.h"
+#include "bits.h"
+#include "trace.h"
+
+#define BATCHSIZE 256      // tuple refs fetched per scan call
+#define COPYBUFSIZE 65536  // bytes copied per read when merging
+
+struct PartsRep {
+	char *name;    // the partitioned relation's name
+	Count k;       // partition bits
+	Count nparts;  // 2^k partitions
+	char **names;  // partition (relation) names
+	Reln *relns;   // open partitions
+};
+
+// state shared by the threads of a parallel scan
+typedef struct ScanState {
+	Query *qs;       // query on each partition to scan
+	FILE **tmp;      // where each partition's matches go
+	long *found;     // #matches in each partition
+	Count n;         // #partitions to scan
+	Count next;      // next partition to hand to a thread
+	Bool countOnly;  // only count matches
+	pthread_mutex_t lock;  // guards next
+} ScanState;
+
+// name of the catalog file of relation name
+
+static void catalogName(char *name, char *fname)
+{
+	sprintf(fname, "%s.parts", name);
+}
+
+// name of partition i of name (whose last component is base) in
+//   pname; it goes in dir[i % ndirs], or alongside name if ndirs is 0
+// returns ~OK if the name is too long
+
+static Status makePartName(char *name, char *base, char **dir, Count ndirs,
+                           Count i, char *pname)
+{
+	int len;
+	if (ndirs == 0)
+		len = snprintf(pname, MAXRELNAME+1, "%s.p%d", name, i);
+	else
+		len = snprintf(pname, MAXRELNAME+1, "%s/%s.p%d",
+		               dir[i % ndirs], base, i);
+	return (len > MAXRELNAME) ? ~OK : OK;
+}
+
+// create the 2^k partitions of a new relation, and its catalog
+// dirs is a comma-separated list of directories that partitions
+//   are placed in, round-robin (NULL = alongside the catalog)
+// the remaining args are as for newRelation()
+
+Status newParts(char *name, Count k, char *dirs, Count nattr, Count npages,
+                Count d, char *cv, Count layout, int sortatt, Count scheme)
+{
+	char fname[MAXFILENAME];
+	char pname[MAXRELNAME+1];
+	if (k < 1 || k > MAXPARTBITS) return -1;
+	char *base = strrchr(name, '/');
+	base = (base == NULL) ? name : base+1;
+
+	// split the directory list
+	Count ndirs = 0;
+	char **dir = malloc(((dirs == NULL) ? 1 : strlen(dirs)+1)*sizeof(char *));
+	assert(dir != NULL);
+	char *dlist = (dirs == NULL) ? NULL : copyString(dirs);
+	if (dlist != NULL) {
+		char *c = dlist;
+		for (;;) {
+			dir[ndirs++] = c;
+			while (*c != ',' && *c != '\0') c++;
+			if (*c == '\0') break;
+			*c++ = '\0';
+		}
+	}
+
+	catalogName(name, fname);
+	FILE *cat = fopen(fname, "w");
+	if (cat == NULL) { free(dir); free(dlist); return -1; }
+	fprintf(cat, "%d\n", k);
+	Status ok = OK;
+	Count i;
+	for (i = 0; i < (1 << k) && ok == OK; i++) {
+		if (makePartName(name, base, dir, ndirs, i, pname) != OK
+		    || existsRelation(pname)
+		    || newRelation(pname, nattr, npages, d, cv,
+		                   layout, sortatt, scheme) != OK)
+			ok = -1;
+		else
+			fprintf(cat, "%s\n", pname);
+	}
+	// partitions made before the one that failed go too, so that
+	//   the same create can be tried again
+	if (ok != OK) {
+		for (Count j = 0; j + 1 < i; j++) {
+			makePartName(name, base, dir, ndirs, j, pname);
+			removeRelation(pname);
+		}
+	}
+	fclose(cat);
+	if (ok != OK) remove(fname);
+	free(dir);
+	free(dlist);
+	return ok;
+}
+
+// is there a partitioned relation called name?
+
+Bool isPartitioned(char *name)
+{
+	char fname[MAXFILENAME];
+	catalogName(name, fname);
+	FILE *f = fopen(fname, "r");
+	if (f == NULL) return FALSE;
+	fclose(f);
+	return TRUE;
+}
+
+// open all of the partitions of a relation
+// mode is as for openRelation(); returns NULL if any partition
+//   can't be opened
+
+Parts openParts(char *name, char *mode)
+{
+	char fname[MAXFILENAME];
+	catalogName(name, fname);
+	FILE *cat = fopen(fname, "r");
+	if (cat == NULL) return NULL;
+	int k;
+	if (fscanf(cat, "%d\n", &k) != 1 || k < 1 || k > MAXPARTBITS) {
+		fclose(cat);
+		return NULL;
+	}
+	Parts new = malloc(sizeof(struct PartsRep));
+	assert(new != NULL);
+	new->name = copyString(name);
+	new->k = k;
+	new->nparts = 1 << k;
+	new->names = calloc(new->nparts, sizeof(char *));
+	new->relns = calloc(new->nparts, sizeof(Reln));
+	assert(new->names != NULL && new->relns != NULL);
+	char *line = NULL;
+	int size = 0;
+	Bool ok = TRUE;
+	for (Count i = 0; i < new->nparts && ok; i++) {
+		if (readLine(cat, &line, &size) == NULL)
+			ok = FALSE;
+		else {
+			new->names[i] = copyString(line);
+			new->relns[i] = openRelation(line, mode);
+			ok = (new->relns[i] != NULL);
+		}
+	}
+	free(line);
+	fclose(cat);
+	if (!ok) {
+		closeParts(new);
+		return NULL;
+	}
+	return new;
+}
+
+// close all partitions, and release the Parts
+
+void closeParts(Parts p)
+{
+	for (Count i = 0; i < p->nparts; i++) {
+		if (p->relns[i] != NULL) closeRelation(p->relns[i]);
+		free(p->names[i]);
+	}
+	free(p->relns);
+	free(p->names);
+	free(p->name);
+	free(p);
+}
+
+// functions giving info about partitions
+
+Count nparts(Parts p) { return p->nparts; }
+
+Count partBits(Parts p) { return p->k; }
+
+Reln partReln(Parts p, Count i) { return p->relns[i]; }
+
+char *partName(Parts p, Count i) { return p->names[i]; }
+
+// insert a tuple into the partition its hash belongs in
+// sets *part to that partition, and returns the page the tuple
+//   went into, as for addToRelation()
+// the trace records an insert into the partitioned relation
+
+PageID addToParts(Parts p, Tuple t, Count *part)
+{
+	HashBits h = tupleHash(p->relns[0], t);
+	*part = partOf(h, p->k);
+	if (!tracing()) return addToRelation(p->relns[*part], t);
+	double start = traceClock();
+	traceSuspend();
+	PageID pid = addToRelation(p->relns[*part], t);
+	traceResume();
+	if (pid != NO_PAGE) traceInsert(p->name, t, start);
+	return pid;
+}
+
+// find the partitions that tuples matching query string q can be
+//   in, from the values it gives for the partition bits' attributes
+// fills which[] (of nparts entries) and returns how many there
+//   are, or -1 if q doesn't have a value for each attribute
+
+int queryParts(Parts p, char *q, Count *which)
+{
+	Reln r = p->relns[0];
+	Count nvals = 1;
+	for (char *c = q; *c != '\0'; c++) {
+		if (*c == ',') nvals++;
+	}
+	if (nvals != nattrs(r)) return -1;
+	char **vals = malloc(nvals*sizeof(char *));
+	assert(vals != NULL);
+	tupleVals(q, vals);
+
+	ChVecItem *cv = chvec(r);
+	Count mask = 0, val = 0;
+	for (Count j = 0; j < p->k; j++) {
+		ChVecItem c = cv[PARTSHIFT(p->k) + j];
+		if (strcmp(vals[c.att], "?") == 0) continue;
+		Bits h = hash_any((unsigned char *)vals[c.att], strlen(vals[c.att]));
+		mask |= 1 << j;
+		if (bitIsSet(h, c.bit)) val |= 1 << j;
+	}
+	freeVals(vals, nvals);
+	free(vals);
+
+	int n = 0;
+	for (Count i = 0; i < p->nparts; i++) {
+		if ((i & mask) == val) which[n++] = i;
+	}
+	return n;
+}
+
+// run query q to the end, writing its matches to out, one per
+//   line; returns how many there were
+
+static long scanQuery(Query q, Bool countOnly, FILE *out)
+{
+	if (countOnly) return countMatches(q);
+	TupleRef refs[BATCHSIZE];
+	long n = 0;
+	int got, i;
+	while ((got = getNextTuples(q, refs, BATCHSIZE)) > 0) {
+		for (i = 0; i < got; i++) {
+			fwrite(refs[i].tup, 1, refs[i].len, out);
+			putc('\n', out);
+		}
+		n += got;
+	}
+	return n;
+}
+
+// scan partitions, as handed out by the shared state, until
+//   there are none left
+
+static void *scanThread(void *arg)
+{
+	ScanState *s = arg;
+	for (;;) {
+		pthread_mutex_lock(&s->lock);
+		Count i = s->next++;
+		pthread_mutex_unlock(&s->lock);
+		if (i >= s->n) break;
+		s->found[i] = scanQuery(s->qs[i], s->countOnly, s->tmp[i]);
+	}
+	return NULL;
+}
+
+// copy lines from in to out, at most limit of them (0 = all)
+// returns how many lines were copied
+
+static long copyLines(FILE *in, FILE *out, long limit)
+{
+	char *buf = malloc(COPYBUFSIZE);
+	assert(buf != NULL);
+	long nlines = 0;
+	size_t n;
+	rewind(in);
+	while ((n = fread(buf, 1, COPYBUFSIZE, in)) > 0) {
+		size_t len = n;
+		for (size_t i = 0; i < n; i++) {
+			if (buf[i] != '\n') continue;
+			if (++nlines == limit) { len = i+1; break; }
+		}
+		fwrite(buf, 1, len, out);
+		if (nlines == limit) break;
+	}
+	free(buf);
+	return nlines;
+}
+
+// run query string q on the partitions it can match, writing
+//   the matching tuples (projected on proj, if not NULL) to out
+// - with countOnly, nothing is written
+// - at most limit tuples are found (0 = all)
+// - up to nthreads partitions are scanned at once (0 = one per
+//   CPU, up to MAXSCANTHREADS), each into a temporary file; the
+//   files are then copied to out in partition order, so the
+//   output doesn't depend on nthreads
+// returns #matching tuples, or -1 if q or proj is invalid
+// the trace records one select on the partitioned relation
+
+long scanParts(Parts p, char *q, char *proj, Count limit, Bool countOnly,
+               Count nthreads, FILE *out)
+{
+	double start = tracing() ? traceClock() : 0;
+	if (start > 0) traceSuspend();
+	Count *which = malloc(p->nparts*sizeof(Count));
+	assert(which != NULL);
+	int n = queryParts(p, q, which);
+	if (n < 0) {
+		if (start > 0) traceResume();
+		free(which);
+		return -1;
+	}
+
+	ScanState s;
+	s.qs = calloc(n, sizeof(Query));
+	s.tmp = calloc(n, sizeof(FILE *));
+	s.found = calloc(n, sizeof(long));
+	assert(s.qs != NULL && s.tmp != NULL && s.found != NULL);
+	s.n = n;  s.next = 0;  s.countOnly = countOnly;
+	long total = 0;
+	Bool ok = TRUE;
+	for (Count i = 0; i < n && ok; i++) {
+		s.qs[i] = startQuery(p->relns[which[i]], q);
+		if (s.qs[i] == NULL)
+			ok = FALSE;
+		else if (proj != NULL && projectQuery(s.qs[i], proj) != OK)
+			ok = FALSE;
+		else if (limit > 0)
+			limitQuery(s.qs[i], limit);
+	}
+
+	if (nthreads == 0) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpus < 1) ? 1 : ncpus;
+		if (nthreads > MAXSCANTHREADS) nthreads = MAXSCANTHREADS;
+	}
+	if (!ok)
+		total = -1;
+	else if (nthreads <= 1 || n <= 1) {
+		// scan one partition at a time, straight to out
+		for (Count i = 0; i < n; i++) {
+			if (limit > 0 && total >= limit) break;
+			if (limit > 0) limitQuery(s.qs[i], limit - total);
+			total += scanQuery(s.qs[i], countOnly, out);
+		}
+	}
+	else {
+		if (nthreads > n) nthreads = n;
+		for (Count i = 0; i < n && !countOnly; i++) {
+			s.tmp[i] = tmpfile();
+			assert(s.tmp[i] != NULL);
+		}
+		pthread_mutex_init(&s.lock, NULL);
+		pthread_t *tids = malloc(nthreads*sizeof(pthread_t));
+		assert(tids != NULL);
+		Count started = 0;
+		while (started < nthreads
+		       && pthread_create(&tids[started], NULL, scanThread, &s) == 0)
+			started++;
+		// if threads run out, this one takes a share of the scans
+		if (started < nthreads) scanThread(&s);
+		for (Count t = 0; t < started; t++)
+			pthread_join(tids[t], NULL);
+		free(tids);
+		pthread_mutex_destroy(&s.lock);
+		for (Count i = 0; i < n; i++) {
+			if (countOnly)
+				total += s.found[i];
+			else if (limit == 0 || total < limit)
+				total += copyLines(s.tmp[i], out,
+				                   limit == 0 ? 0 : limit - total);
+		}
+		if (limit > 0 && total > limit) total = limit;
+	}
+
+	for (Count i = 0; i < n; i++) {
+		if (s.qs[i] != NULL) closeQuery(s.qs[i]);
+		if (s.tmp[i] != NULL) fclose(s.tmp[i]);
+	}
+	free(s.qs);
+	free(s.tmp);
+	free(s.found);
+	free(which);
+	if (start > 0) {
+		traceResume();
+		if (total >= 0) traceSelect(p->name, q, start, total);
+	}
+	return total;
+}
+
+// show the size and shape of each partition, and the totals
+
+void partsStats(Parts p)
+{
+	Count tups = 0, pages = 0;
+	printf("Partitioned on %d hash bits (bits %d..%d)\n",
+	       p->k, PARTSHIFT(p->k), PARTSHIFT(p->k) + p->k - 1);
+	printf("%-4s %-24s %s\n", "#", "relation", "(#tuples,#pages,d,sp)");
+	for (Count i = 0; i < p->nparts; i++) {
+		Reln r = p->relns[i];
+		printf("[%2d] %-24s (%d,%d,%d,%d)\n", i, p->names[i],
+		       ntuples(r), npages(r), depth(r), splitp(r));
+		tups += ntuples(r);
+		pages += npages(r);
+	}
+	printf("total: #tuples:%d  #pages:%d\n", tups, pages);
+}
@@ -0,0 +1,38 @@
+// part.h ... interface to partitioned relations
+// part of Multi-attribute Linear-hashed Files
+// See part.c for details of Parts type and functions
+
+#ifndef PART_H
+#define PART_H 1
+
+typedef struct PartsRep *Parts;
+
+#include "defs.h"
+#include "reln.h"
+#include "tuple.h"
+
+// a relation is split into 2^K partitions on the K composite
+//   hash bits just below the hot segment bits
+#define MAXPARTBITS 6
+#define PARTSHIFT(k) (MAXBITS - HOTSEGBITS - (k))
+#define partOf(h,k) (((h) >> PARTSHIFT(k)) & ((1 << (k)) - 1))
+
+// at most this many partitions are scanned at once
+#define MAXSCANTHREADS 8
+
+Status newParts(char *name, Count k, char *dirs, Count nattr, Count npages,
+                Count d, char *cv, Count layout, int sortatt, Count scheme);
+Bool isPartitioned(char *name);
+Parts openParts(char *name, char *mode);
+void closeParts(Parts p);
+Count nparts(Parts p);
+Count partBits(Parts p);
+Reln partReln(Parts p, Count i);
+char *partName(Parts p, Count i);
+PageID addToParts(Parts p, Tuple t, Count *part);
+int queryParts(Parts p, char *q, Count *which);
+long scanParts(Parts p, char *q, char *proj, Count limit, Bool countOnly,
+               Count nthreads, FILE *out);
+void partsStats(Parts p);
+
+#endif
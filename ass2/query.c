@@ -9,25 +9,84 @@
 #include "reln.h"
 #include "tuple.h"
 #include "hash.h"
+#include "lob.h"
+#include "trace.h"
 
 
 struct QueryRep {
     Tuple   query;      // query's corresponding tuple with "?"
     Reln    rel;        // need to remember Relation info
 
-    Bits    known;      // the known bits from MAH
-    Bits    unknown;    // the current unknown bits from MAH
+    HashBits known;     // the known bits from MAH
+    Bits    khash[MAXATTRS]; // hash of each known attribute value
+    HashBits unknown;   // the current unknown bits from MAH
     int     nstars;     // number of unknown bits in depth+1 lower bits from MAH
     Byte    *starBits;  // unknown bits' position in MAH (length == nstars <= 32)
 
     Bits    bitSeq;     // current possible unknown bits combination
     Bits    bitSeqMax;  // bitSeq < 2^nstars
+    HashBits kmask;     // which bits of known are known (not linear hashing)
+    HashPos from;       // place in bucket scan (not linear hashing)
 
-    Page    curpage;    // current page in scan
-    Tuple   curtup;     // Tuple that being scanned in data[]
-    Count   nTupleScanned; // number of tuples scanned in this page
+    char    **vals;     // query's attribute values
+    Count   nknown;     // number of attributes that are not "?"
+    Count   katts[MAXATTRS]; // which attributes are known
+    int     vlen[MAXATTRS];  // length of each known value
+    Count   nproj;      // number of projected attributes (0 = whole tuple)
+    Count   proj[MAXATTRS];  // projected attributes, in output order
+    Count   lastatt;    // last attribute that matching/projection looks at
+
+    Bool    started;    // has the scan fetched its first page?
+    Page    curpage;    // current page in scan (NULL when finished)
+    PageScan scan;      // position of scan in current page
+    char    *batch;     // built tuples returned by getNextTuples()
+    int     batchsize;  // #bytes allocated in batch
+    char    *lobbuf;    // tuple rebuilt with its values from rel.lob
+    int     lobsize;    // #bytes allocated in lobbuf
+    char    *projbuf;   // projected values of a matching tuple
+    int     projsize;   // #bytes allocated in projbuf
+
+    Count   limit;      // stop after this many matches (0 = no limit)
+    Count   nfound;     // number of matches returned so far
+
+    int     skey;       // sort attribute, if buckets are sorted and
+                        //   the query knows its value (else -1)
+    Count   pagesLeft;  // pages of the bucket that may still match,
+                        //   including the current one (if skey >= 0),
+                        //   or of the current hot bucket segment
+    PageID  bucket;     // bucket being scanned
+    Count   seg;        // hot bucket segment being scanned (or NHOTSEG)
+    Bits    smask;      // known bits of hot bucket segment numbers
+    Bits    sval;       // and their values
+
+    double  tstart;     // when the query began, if it is to be
+                        //   recorded in the trace (else 0)
 };
 
+// find next matching tuple in the current page
+static Tuple nextMatch(Query q, Bool build);
+// check a row-packed tuple against the query
+static Bool rowMatch(Query q, Tuple t, char **val, int *len);
+// check a value moved to rel.lob against the query
+static Bool lobMatch(Query q, Count a, char *v, int len);
+// build a projected tuple from attribute values
+static Tuple projectValues(Query q, char **val, int *len);
+// form known bits from the known attributes' hashes
+static void formKnownBits(Query q);
+// #bits of the composite hash that place a bucket
+static Count hashBits(Reln r);
+// bucket for the current combination of unknown bits
+static Bool bucketFor(Query q, PageID *p);
+// buckets the scan has to look at, in order
+static Bool firstBucket(Query q, PageID *p);
+static Bool nextBucket(Query q, PageID *p);
+// fetch the first page of the scan
+static void startScan(Query q);
+// fetch the first page of a bucket that may hold matches
+static void openBucket(Query q, PageID p);
+// make room in the buffer for getNextTuples()' built tuples
+static char *growBatch(Query q, TupleRef *out, int n, char *buf, int need);
+
 // take a query string (e.g. "1234,?,abc,?")
 // set up a QueryRep object for the scan
 
@@ -49,12 +108,19 @@ Query startQuery(Reln r, char *q)
     char **vals = malloc(nvals*sizeof(char *));
     assert(vals != NULL);
     tupleVals(new->query, vals);
+    new->vals = vals;
+    new->nknown = 0;
+    for (int i = 0; i < nvals; i++) {
+        new->vlen[i] = strlen(vals[i]);
+        if (strcmp(vals[i], "?") != 0) new->katts[new->nknown++] = i;
+    }
+    new->nproj = 0;
+    new->lastatt = new->nknown > 0 ? new->katts[new->nknown-1] : 0;
 
     // hash vals of attributes
-    Bits hashVals[nvals];
     for (int i = 0; i < nvals; i++) {
         if (strcmp(vals[i], "?") != 0) {
-            hashVals[i] = hash_any((unsigned char *)vals[i],strlen(vals[i]));
+            new->khash[i] = hash_any((unsigned char *)vals[i],strlen(vals[i]));
         }
     }
 
@@ -63,15 +129,17 @@ Query startQuery(Reln r, char *q)
     // only care about depth+1 lower bits
     ChVecItem *cv = chvec(r);
     for (int i = 0; i < depth(r)+1; i++) {
-        if (strcmp(vals[cv[i].att], "?") != 0) {
-            if (bitIsSet(hashVals[cv[i].att], cv[i].bit)) {
-                new->known = setBit(new->known, i);
-            }
-        } else {
+        if (strcmp(vals[cv[i].att], "?") == 0) {
             new->starBits[new->nstars] = i;
             new->nstars++;
         }
     }
+    new->kmask = 0;
+    for (int i = 0; i < hashBits(r); i++) {
+        if (strcmp(vals[cv[i].att], "?") != 0)
+            new->kmask = setBit(new->kmask, i);
+    }
+    formKnownBits(new);
 
     // start query with a page that all stars in depth+1
     // lower bits are 0, end query with a page that all stars
@@ -82,119 +150,508 @@ Query startQuery(Reln r, char *q)
         new->bitSeqMax = setBit(new->bitSeqMax, i);
     }
 
-    // form current unknown bits from nstars, starBits[], bitSeq
-    for (int i = 0; i < new->nstars; i++) {
-        if (bitIsSet(new->bitSeq, i)) {
-            new->unknown = setBit(new->unknown, new->starBits[i]);
+    // first page is fetched when the first tuple is asked for
+    new->started = FALSE;
+    new->curpage = NULL;
+    // reassembled tuples take no more room than the page they came
+    //   from, but those with values from rel.lob may need more
+    new->batchsize = PAGESIZE;
+    new->batch = malloc(new->batchsize);
+    assert(new->batch != NULL);
+    new->lobbuf = NULL;
+    new->lobsize = 0;
+    new->projbuf = NULL;
+    new->projsize = 0;
+    new->limit = 0;
+    new->nfound = 0;
+    // sorted buckets are only searched for the pages holding
+    //   the wanted sort attribute value
+    new->skey = sortAttr(r);
+    if (new->skey >= 0 && vals[new->skey][0] == '?') new->skey = -1;
+    new->pagesLeft = 0;
+    new->tstart = tracing() ? traceClock() : 0;
+    return new;
+}
+
+static void formKnownBits(Query q)
+{
+    ChVecItem *cv = chvec(q->rel);
+    q->known = 0;
+    for (int i = 0; i < hashBits(q->rel); i++) {
+        if (q->vals[cv[i].att][0] == '?' && q->vlen[cv[i].att] == 1) continue;
+        if (bitIsSet(q->khash[cv[i].att], cv[i].bit)) {
+            q->known = setBit(q->known, i);
         }
     }
+    q->smask = q->sval = 0;
+    for (int k = 0; k < HOTSEGBITS; k++) {
+        ChVecItem c = cv[MAXBITS - HOTSEGBITS + k];
+        if (q->vals[c.att][0] == '?' && q->vlen[c.att] == 1) continue;
+        q->smask = setBit(q->smask, k);
+        if (bitIsSet(q->khash[c.att], c.bit)) q->sval = setBit(q->sval, k);
+    }
+}
 
-    // compute PageID of first page
-    //   using known bits and first "unknown" value
-    Bits malHash = new->unknown | new->known;
-    Bits p = getLower(malHash, depth(new->rel));
-    if (p < splitp(new->rel)) p = getLower(malHash, depth(new->rel)+1);
-    new->curpage = getPage(dataFile(new->rel), p);
-    new->curtup = pageData(new->curpage);
-    new->nTupleScanned = 0;
-    freeVals(vals, nvals);
-    return new;
+// linear hashing only needs depth+1 bits, extendible hashing's
+//   directory uses depth bits, and spiral storage places buckets
+//   by the low SPIRALBITS bits of the hash
+
+static Count hashBits(Reln r)
+{
+    switch (hashScheme(r)) {
+    case SPIRAL_HASH: return SPIRALBITS;
+    case EXTENDIBLE_HASH: return depth(r);
+    default: return depth(r)+1;
+    }
 }
 
-// get next tuple during a scan
+// compute PageID of the bucket using known bits and
+//   the "unknown" value given by bitSeq
+// returns FALSE if that bucket does not exist (yet)
 
-Tuple getNextTuple(Query q)
+static Bool bucketFor(Query q, PageID *pid)
 {
-    Tuple result = NULL;
-    // always get in remaining buckets until get one tuple or NULL
-    while (TRUE) {
-        // scan tuples in current primary page
-        while (q->nTupleScanned < pageNTuples(q->curpage)) {
-            if (tupleMatch(q->rel, q->query, q->curtup)) {
-                result = q->curtup;
-            }
-            while (*q->curtup != '\0') q->curtup++;
-            q->curtup++;
-            q->nTupleScanned++;
-            if (result != NULL) return result;
+    // form current unknown bits from nstars, starBits[], bitSeq
+    q->unknown = 0;
+    for (int i = 0; i < q->nstars; i++) {
+        if (bitIsSet(q->bitSeq, i)) {
+            q->unknown = setBit(q->unknown, q->starBits[i]);
         }
+    }
+    HashBits malHash = q->unknown | q->known;
+    PageID p;
+    if (q->nstars == 0 || q->starBits[q->nstars-1] != depth(q->rel)) {
+        // at this point, the bit at depth+1 is not *, it must either be 1 or 0
+        // we can normally get depth or depth+1 lower bits depending on sp position
+        p = getLower(malHash, depth(q->rel));
+        if (p < splitp(q->rel)) p = getLower(malHash, depth(q->rel)+1);
+    } else {
+        // if depth+1 bit is *, we must use depth+1 bits for all pages
+        // as (assume depth is 2) when we get depth bits, some 0XX page will be
+        // scanned again when we attempt to scan 1XX page
+        // we check if hash < npages as some 1XX page may not exist
+        p = getLower(malHash, depth(q->rel)+1);
+        if (p >= npages(q->rel)) return FALSE;
+    }
+    *pid = p;
+    return TRUE;
+}
 
-        // at this point, primary page of this
-        // bucket has no matched tuple
-        // scan all overflow pages in this bucket
-        while (pageOvflow(q->curpage) != NO_PAGE) {
-            // no more tuples in current page
-            // close it and open overflow page
-            Page tmp = q->curpage;
-            q->curpage = getPage(ovflowFile(q->rel), pageOvflow(q->curpage));
-            free(tmp);
-            q->nTupleScanned = 0;
-            q->curtup = pageData(q->curpage);
-            while (q->nTupleScanned < pageNTuples(q->curpage)) {
-                if (tupleMatch(q->rel, q->query, q->curtup)) {
-                    result = q->curtup;
+// spiral and extendible hashing relations find the buckets that
+//   match the known bits themselves; otherwise, each combination
+//   of unknown bits gives a bucket (or one not there yet)
+
+static Bool firstBucket(Query q, PageID *p)
+{
+    q->bitSeq = 0;
+    q->from = 0;
+    if (hashScheme(q->rel) != LINEAR_HASH)
+        return nextHashBucket(q->rel, q->kmask, q->known, &q->from, p);
+    // all stars 0 always gives an existing bucket
+    return bucketFor(q, p);
+}
+
+// returns FALSE when there are no more buckets
+
+static Bool nextBucket(Query q, PageID *p)
+{
+    if (hashScheme(q->rel) != LINEAR_HASH)
+        return nextHashBucket(q->rel, q->kmask, q->known, &q->from, p);
+    // if a combination's bucket does not exist,
+    //   go on to the next possible bucket
+    while (q->bitSeq != q->bitSeqMax) {
+        q->bitSeq++;
+        if (bucketFor(q, p)) return TRUE;
+    }
+    return FALSE;
+}
+
+static void startScan(Query q)
+{
+    PageID p;
+    q->started = TRUE;
+    Bool ok = firstBucket(q, &p);
+    assert(ok);
+    openBucket(q, p);
+}
+
+static void openBucket(Query q, PageID p)
+{
+    q->bucket = p;
+    q->seg = NHOTSEG;
+    if (q->skey >= 0)
+        q->curpage = seekBucketPage(q->rel, p, q->vals[q->skey],
+                                    &q->pagesLeft);
+    else if (hotBucket(q->rel, p)) {
+        // segment 0 starts with the primary page, which is always
+        //   read; the rest of it only if it may match
+        q->seg = 0;
+        q->curpage = hotSegmentPage(q->rel, p, 0, &q->pagesLeft);
+        if (q->sval != 0) q->pagesLeft = 1;
+    }
+    else
+        q->curpage = firstBucketPage(q->rel, p);
+    startPageScan(&q->scan, q->curpage, nattrs(q->rel), layout(q->rel));
+}
+
+// find next matching tuple in the current page
+// if build is FALSE, PAX tuples are not reassembled, and
+//   the (non-NULL) result only signals that there was a match
+
+static Tuple nextMatch(Query q, Bool build)
+{
+    PageScan *s = &q->scan;
+    if (!q->started) startScan(q);
+    if (q->curpage == NULL) return NULL;
+    if (q->limit > 0 && q->nfound >= q->limit) return NULL;
+    char *val[MAXATTRS];
+    int len[MAXATTRS];
+    if (s->layout == ROW_LAYOUT) {
+        Tuple t;
+        while ((t = nextPageTuple(s)) != NULL) {
+            // every tuple matches an all-"?" query
+            if (q->nknown == 0 && q->nproj == 0) {
+                q->nfound++;
+                return t;
+            }
+            if (rowMatch(q, t, val, len)) {
+                q->nfound++;
+                if (!build || q->nproj == 0) return t;
+                return projectValues(q, val, len);
+            }
+            // in a sorted bucket, nothing after a larger key matches
+            if (q->skey >= 0) {
+                int klen;
+                char *k = tupleAttr(t, q->skey, &klen);
+                if (compareVals(k, klen, q->vals[q->skey],
+                                q->vlen[q->skey]) > 0) {
+                    q->pagesLeft = 0;
+                    return NULL;
                 }
-                q->nTupleScanned++;
-                while (*q->curtup != '\0') q->curtup++;
-                q->curtup++;
-                if (result != NULL) return result;
             }
         }
+        return NULL;
+    }
+    // PAX page: check known attributes one minipage at a time,
+    // and only reassemble tuples that match all of them
+    Count n = pageNTuples(q->curpage);
+    while (s->next < n) {
+        Count i = s->next++, k;
+        for (k = 0; k < q->nknown; k++) {
+            Count a = q->katts[k];
+            char *v = pageScanValue(s, i, a);
+            if (strcmp(v, q->vals[a]) != 0 && !lobMatch(q, a, v, strlen(v)))
+                break;
+        }
+        if (k == q->nknown) {
+            q->nfound++;
+            if (!build) return s->buf;
+            if (q->nproj == 0) return pageScanTuple(s, i);
+            // only the projected minipages are touched
+            for (k = 0; k < q->nproj; k++) {
+                Count a = q->proj[k];
+                val[a] = pageScanValue(s, i, a);
+                len[a] = strlen(val[a]);
+            }
+            return projectValues(q, val, len);
+        }
+    }
+    return NULL;
+}
+
+// compare a row-packed tuple with the query in one pass over its
+//   bytes, without copying any values
+// on a match, val[a],len[a] give the position of each attribute
+//   up to q->lastatt; the rest of the tuple is not looked at
 
-        // at this point, current page that just has been scanned must be
-        // the last page in this bucket,
-        // if current bucket is the last possible bucket,
-        // no more pages can be scanned, close it and return NULL
-        if (q->bitSeq == q->bitSeqMax) {
-            free(q->curpage);
-            return NULL;
+static Bool rowMatch(Query q, Tuple t, char **val, int *len)
+{
+    char *c = t;
+    Count a = 0;
+    for (;;) {
+        char *v = c;
+        while (*c != ',' && *c != '\0') c++;
+        // assumes no real attribute values start with '?'
+        if (q->vals[a][0] != '?') {
+            if ((c-v != q->vlen[a] || memcmp(v, q->vals[a], c-v) != 0)
+                && !lobMatch(q, a, v, c-v))
+                return FALSE;
         }
+        val[a] = v; len[a] = c-v;
+        if (*c == '\0' || a == q->lastatt) break;
+        c++; a++;
+    }
+    return TRUE;
+}
 
-        // if have more possible buckets, move to next bucket
-        q->bitSeq++;
-        // form current unknown bits from nstars, starBits[], bitSeq
-        q->unknown = 0;
-        for (int i = 0; i < q->nstars; i++) {
-            if (bitIsSet(q->bitSeq, i)) {
-                q->unknown = setBit(q->unknown, q->starBits[i]);
+// a value in rel.lob can only match if its length and hash do,
+//   and is only read from rel.lob then
+
+static Bool lobMatch(Query q, Count a, char *v, int len)
+{
+    FILE *lob = lobFile(q->rel);
+    if (lob == NULL || !isLobRef(v, len)) return FALSE;
+    if (lobRefLength(v) != q->vlen[a] || lobRefHash(v) != q->khash[a])
+        return FALSE;
+    char *buf = malloc(q->vlen[a]+1);
+    assert(buf != NULL);
+    Bool match = strcmp(lobGet(lob, v, buf), q->vals[a]) == 0;
+    free(buf);
+    return match;
+}
+
+// join the projected attribute values into the query's projection
+//   buffer, grown as needed (an attribute may be projected more
+//   than once, so the result can be longer than the tuple)
+
+static Tuple projectValues(Query q, char **val, int *len)
+{
+    int need = q->nproj;
+    for (Count k = 0; k < q->nproj; k++) need += len[q->proj[k]];
+    if (q->projsize < need) {
+        q->projsize = need;
+        q->projbuf = realloc(q->projbuf, q->projsize);
+        assert(q->projbuf != NULL);
+    }
+    char *c = q->projbuf;
+    for (Count k = 0; k < q->nproj; k++) {
+        Count a = q->proj[k];
+        if (k > 0) *c++ = ',';
+        memcpy(c, val[a], len[a]);
+        c += len[a];
+    }
+    *c = '\0';
+    return q->projbuf;
+}
+
+// move scan to the next page that might hold matching tuples
+// returns FALSE (and releases the last page) when no pages remain
+
+static Bool nextPage(Query q)
+{
+    if (q->curpage == NULL) return FALSE;
+    // no more pages needed once the limit is reached
+    if (q->limit > 0 && q->nfound >= q->limit) {
+        free(q->curpage);
+        q->curpage = NULL;
+        return FALSE;
+    }
+    // scan all overflow pages in this bucket
+    // (only those that may match, if the bucket is sorted or hot)
+    if (pageOvflow(q->curpage) != NO_PAGE
+        && ((q->skey < 0 && q->seg == NHOTSEG) || q->pagesLeft > 1)) {
+        // no more tuples in current page
+        // close it and open overflow page
+        q->pagesLeft--;
+        q->curpage = nextBucketPage(q->rel, q->curpage);
+        startPageScan(&q->scan, q->curpage, nattrs(q->rel), layout(q->rel));
+        return TRUE;
+    }
+    // a hot bucket goes on with its next segment that may match
+    while (q->seg + 1 < NHOTSEG) {
+        q->seg++;
+        if ((q->seg & q->smask) != q->sval) continue;
+        Page pg = hotSegmentPage(q->rel, q->bucket, q->seg, &q->pagesLeft);
+        if (pg == NULL) continue;
+        free(q->curpage);
+        q->curpage = pg;
+        startPageScan(&q->scan, q->curpage, nattrs(q->rel), layout(q->rel));
+        return TRUE;
+    }
+    // at this point, current page that just has been scanned must be
+    // the last page in this bucket,
+    // if current bucket is the last possible bucket,
+    // no more pages can be scanned, close it and return FALSE
+    // if have more possible buckets, move to next bucket
+    PageID p;
+    free(q->curpage);
+    if (!nextBucket(q, &p)) {
+        q->curpage = NULL;
+        return FALSE;
+    }
+    openBucket(q, p);
+    return TRUE;
+}
+
+// get next tuple during a scan
+
+Tuple getNextTuple(Query q)
+{
+    Tuple result;
+    // always get in remaining pages until get one tuple or NULL
+    do {
+        if ((result = nextMatch(q, TRUE)) != NULL)
+            return lobResolve(lobFile(q->rel), result, &q->lobbuf, &q->lobsize);
+    } while (nextPage(q));
+    return NULL;
+}
+
+// make room for need more bytes after buf in q's batch buffer,
+//   moving the n tuples already in out[] along with it
+// returns the new position of buf
+
+static char *growBatch(Query q, TupleRef *out, int n, char *buf, int need)
+{
+    int used = buf - q->batch, size = q->batchsize;
+    while (used + need > size) size *= 2;
+    char *batch = malloc(size);
+    assert(batch != NULL);
+    memcpy(batch, q->batch, used);
+    for (int k = 0; k < n; k++) {
+        if (out[k].tup >= q->batch && out[k].tup < buf)
+            out[k].tup = batch + (out[k].tup - q->batch);
+    }
+    free(q->batch);
+    q->batch = batch;
+    q->batchsize = size;
+    return batch + used;
+}
+
+// get up to max matching tuples from the next page that has any
+// references point into the query's current page (or its batch
+//   buffer, for reassembled PAX tuples), so they are only valid
+//   until the next call on this query
+// returns number of tuples placed in out[], or 0 at end of scan
+
+int getNextTuples(Query q, TupleRef *out, int max)
+{
+    int n = 0;
+    char *buf = q->batch;
+    if (!q->started) startScan(q);
+    while (TRUE) {
+        if (q->curpage == NULL) return 0;
+        Tuple t;
+        while (n < max && (t = nextMatch(q, TRUE)) != NULL) {
+            t = lobResolve(lobFile(q->rel), t, &q->lobbuf, &q->lobsize);
+            int len = strlen(t);
+            if (t == q->scan.buf || t == q->lobbuf || t == q->projbuf) {
+                // PAX, projected or rebuilt tuple; copy out of the
+                //   scan's buffer
+                if (buf + len+1 > q->batch + q->batchsize)
+                    buf = growBatch(q, out, n, buf, len+1);
+                memcpy(buf, t, len+1);
+                t = buf;
+                buf += len+1;
             }
+            out[n].tup = t;
+            out[n].len = len;
+            n++;
         }
+        // stay on this page until all its matches are delivered
+        if (n > 0) return n;
+        if (!nextPage(q)) return 0;
+    }
+}
 
+// restrict the scan's output to a list of attributes
+// attrs is a comma-separated list of attribute numbers, e.g. "2,0"
 
-        // compute PageID of next bucket page
-        // using known bits and current "unknown" value
-        Bits malHash = q->unknown | q->known;
-        if (q->starBits[q->nstars-1] != depth(q->rel)) {
-            // at this point, the bit at depth+1 is not *, it must either be 1 or 0
-            // we can normally get depth or depth+1 lower bits depending on sp position
-            Bits p = getLower(malHash, depth(q->rel));
-            if (p < splitp(q->rel)) p = getLower(malHash, depth(q->rel)+1);
-            free(q->curpage);
-            q->curpage = getPage(dataFile(q->rel), p);
-            q->nTupleScanned = 0;
-            q->curtup = pageData(q->curpage);
-        } else {
-            // if depth+1 bit is *, we must use depth+1 bits for all pages
-            // as (assume depth is 2) when we get depth bits, some 0XX page will be
-            // scanned again when we attempt to scan 1XX page
-            // we check if hash < npages as some 1XX page may not exist
-            // if not exist, go to next iteration to compute next possible bucket
-            Bits p = getLower(malHash, depth(q->rel)+1);
-            if (p < npages(q->rel)) {
-                free(q->curpage);
-                q->curpage = getPage(dataFile(q->rel), p);
-                q->nTupleScanned = 0;
-                q->curtup = pageData(q->curpage);
-            }
+Status projectQuery(Query q, char *attrs)
+{
+    Count n = 0;
+    char *c = attrs;
+    while (*c != '\0') {
+        char *end;
+        long a = strtol(c, &end, 10);
+        if (end == c || a < 0 || a >= nattrs(q->rel) || n == MAXATTRS)
+            return ~OK;
+        q->proj[n++] = a;
+        if (a > q->lastatt) q->lastatt = a;
+        c = end;
+        if (*c == ',') c++;
+        else if (*c != '\0') return ~OK;
+    }
+    if (n == 0) return ~OK;
+    q->nproj = n;
+    return OK;
+}
+
+// stop the scan after n more matching tuples
+
+void limitQuery(Query q, Count n)
+{
+    q->limit = q->nfound + n;
+}
+
+// count the remaining matching tuples without materialising them
+// an all-"?" query is answered from the tuple counts in page headers
+
+Count countMatches(Query q)
+{
+    Count n = 0;
+    if (!q->started) startScan(q);
+    if (q->curpage == NULL) return 0;
+    do {
+        if (q->nknown == 0) {
+            Count left = pageNTuples(q->curpage) - q->scan.next;
+            if (q->limit > 0 && q->nfound + left > q->limit)
+                left = q->limit - q->nfound;
+            q->scan.next += left;
+            q->nfound += left;
+            n += left;
+        }
+        else {
+            while (nextMatch(q, FALSE) != NULL) n++;
         }
+    } while (nextPage(q));
+    return n;
+}
+
+// change the value of known attribute a, keeping the rest of
+//   the query's setup, and rewind the scan
+// lets one query be reused for many probes on the same attribute
+
+Status rebindQuery(Query q, Count a, char *val)
+{
+    if (a >= nattrs(q->rel) || q->vals[a][0] == '?') return ~OK;
+    if (strcmp(val, "?") == 0) return ~OK;
+    free(q->vals[a]);
+    q->vals[a] = copyString(val);
+    q->vlen[a] = strlen(val);
+    q->khash[a] = hash_any((unsigned char *)val, q->vlen[a]);
+    formKnownBits(q);
+    if (q->curpage != NULL) free(q->curpage);
+    q->curpage = NULL;
+    q->started = FALSE;
+    q->nfound = 0;
+    // a query used for many probes isn't one select any more
+    q->tstart = 0;
+    return OK;
+}
+
+// list the buckets that the query would scan
+// returns the number of bucket ids placed in out[] (at most max)
+
+Count queryBuckets(Query q, PageID *out, Count max)
+{
+    Count n = 0;
+    Bits seq = q->bitSeq;
+    HashPos from = q->from;
+    PageID p;
+    Bool more = firstBucket(q, &p);
+    while (more && n < max) {
+        out[n++] = p;
+        more = nextBucket(q, &p);
     }
+    q->bitSeq = seq;
+    q->from = from;
+    return n;
 }
 
 // clean up a QueryRep object and associated data
+// the query is recorded in the trace, if there is one
 
 void closeQuery(Query q)
 {
+    if (q->tstart > 0)
+        traceSelect(relName(q->rel), q->query, q->tstart, q->nfound);
     free(q->query);
+    freeVals(q->vals, nattrs(q->rel));
+    free(q->vals);
     free(q->starBits);
+    free(q->batch);
+    free(q->lobbuf);
+    free(q->projbuf);
+    if (q->curpage != NULL) free(q->curpage);
     free(q);
 }
@@ -8,11 +8,20 @@
 
 typedef struct QueryRep *Query;
 
+// reference to a matching tuple returned by a batch scan
+typedef struct TupleRef { char *tup; int len; } TupleRef;
+
 #include "reln.h"
 #include "tuple.h"
 
 Query startQuery(Reln, char *);
 Tuple getNextTuple(Query);
+int getNextTuples(Query, TupleRef *, int);
+Status projectQuery(Query, char *);
+void limitQuery(Query, Count);
+Count countMatches(Query);
+Status rebindQuery(Query, Count, char *);
+Count queryBuckets(Query, PageID *, Count);
 void closeQuery(Query);
 
 #endif
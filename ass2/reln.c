@@ -9,8 +9,72 @@
 #include "chvec.h"
 #include "bits.h"
 #include "hash.h"
+#include "hll.h"
+#include "lob.h"
+#include "trace.h"
+#include <math.h>
 
 #define HEADERSIZE (3*sizeof(Count)+sizeof(Offset))
+// number of Count-sized fields at the start of RelnRep
+//   that are saved in the .info file
+#define NINFO 12
+// the .info file starts with INFO_MAGIC and its format version;
+//   version 1 files (32-bit choice vectors) have no header, and
+//   start with nattrs, which is never INFO_MAGIC
+#define INFO_MAGIC 0x484c414d
+#define INFO_VERSION 2
+// the .bstats file starts with BSTATS_MAGIC, then the #buckets and
+//   #tuples the counters are for, which must match the .info file
+#define BSTATS_MAGIC 0x5453424c
+#define V1CHVEC 32
+// most overflow pages reserved for a bucket at a time
+#define OVEXTENT 8
+// length of the key prefixes kept in fence directories
+#define FENCELEN 20
+// most hash bits an extendible hashing directory uses
+#define MAXDIRDEPTH 20
+// files of a relation (rel.suffix) that freezeRelation() rewrites
+//   (rel.lob is left as it is)
+static char *relnFiles[] = { "info", "data", "ovflow", "bstats", "free",
+                             "fence", "hot", "dir", NULL };
+// chain length (in pages) at which a bucket is made hot
+#define HOTCHAIN 8
+// how full (%) splitting after every c insertions keeps pages
+#define FILLPCT 70
+
+// overflow pages set aside for a bucket's chain to grow into
+typedef struct OvExtent {
+    PageID next;   // first unused reserved page
+    Count  n;      // #unused reserved pages
+} OvExtent;
+
+// first sort key (prefix) of a page in a sorted bucket
+typedef struct Fence {
+    PageID pid;            // the page; the primary page comes first
+    char   key[FENCELEN];  // prefix of its first key ("" for primary)
+} Fence;
+
+// bucket of an extendible hashing relation
+typedef struct DirBucket {
+    Count ldepth;  // #low hash bits its tuples all share
+    Count nosplit; // don't try splitting again below this many tuples
+} DirBucket;
+
+// segments of a hot bucket's chain, in chain order
+// segment 0 starts with the primary page, which is never last[]
+typedef struct HotDir {
+    PageID first[NHOTSEG];  // first page of segment (if any)
+    PageID last[NHOTSEG];   // last page of segment (NO_PAGE = primary)
+    Count  npages[NHOTSEG]; // #pages in segment
+} HotDir;
+
+// fence directory of a sorted bucket, in chain (and key) order
+typedef struct FenceDir {
+    Bool   loaded; // read from rel.fence, or set up
+    Count  n;      // #pages in bucket
+    Count  max;    // #entries allocated in f
+    Fence *f;
+} FenceDir;
 
 struct RelnRep {
     Count  nattrs;      // number of attributes
@@ -18,50 +82,190 @@ struct RelnRep {
     Offset sp;          // split pointer
     Count  npages;      // number of main data pages
     Count  ntups;       // total number of tuples
-    Count  c;           // capacity of a page, 
-                        // split sp after c insertions
-    Count  insertion;   // insertion times after last split
+    Count  c;           // split sp after c bytes of tuples
+                        //   are inserted (FILLPCT% of a page)
+    Count  insertion;   // bytes inserted since last split
     Count  splitting;   // if the reln is spliting sp
+    Count  layout;      // ROW_LAYOUT or PAX_LAYOUT pages
+    Count  frozen;      // rewritten read-only by freezeRelation()
+    Count  sortkey;     // 1 + attribute buckets are sorted on, or 0
+    Count  scheme;      // LINEAR_HASH or SPIRAL_HASH
 
+    Count  version;     // format of the .info file it was read from
     ChVec  cv;     // choice vector
+    Byte  *hll;    // HyperLogLog sketch for each attribute
     char   mode;   // open for read/write
     FILE  *info;   // handle on info file
     FILE  *data;   // handle on data file
     FILE  *ovflow; // handle on ovflow file
-
-
+    FILE  *lob;    // handle on lob file (NULL until a value is moved)
+    char  *name;   // relation name, to find its other files
+    BucketStats *bstats; // per-bucket counters (NULL until needed)
+    Count  nbstats;      // #entries allocated in bstats
+    PageID *freep;  // free overflow pages (from rel.free)
+    Count  nfree;   // #entries in freep
+    Count  maxfree; // #entries allocated in freep
+    OvExtent *resv; // reserved overflow pages of each bucket
+    Count  maxresv; // #entries allocated in resv
+    FenceDir *fences; // sorted relations only (NULL until needed)
+    Count  maxfences; // #entries allocated in fences
+    FILE  *fencef;    // rel.fence, for loading directories
+    Count  nfencef;   // #buckets in rel.fence
+    // extendible hashing relations only (depth is the global depth)
+    PageID *dir;      // bucket for each value of the low depth bits
+    DirBucket *dirb;  // each bucket's local depth
+    Count  maxdirb;   // #entries allocated in dirb
+    HotDir **hot;     // segments of each hot bucket (from rel.hot)
+    Count  maxhot;    // #entries allocated in hot
+    // frozen relations only
+    Offset *extent; // bucket b is data pages extent[b]..extent[b+1]-1
+    Page   ebuf;    // pages of the extent read most recently
+    PageID ebucket; // bucket that ebuf holds
 };
 
 // function for splitting
 static void splitSp(Reln r);
+// add tuple to a page in bucket b using the relation's page layout
+static Status addTuple(Reln r, PageID b, Page p, Tuple t);
+// bucket b has grown by one (empty) page
+static void noteNewPage(Reln r, PageID b);
+// bytes available in an empty page
+static Count emptyPageSpace();
+// recompute per-bucket counters by reading every page
+static void scanBucketStats(Reln r, BucketStats *bs, Bool show);
+// overflow page allocation, reusing pages freed by vacuumBucket()
+static PageID newOvflowPage(Reln r, PageID b);
+static PageID newOvflowRun(Reln r, Count k);
+static void freeOvflowPage(Reln r, PageID pid);
+static void loadFreeList(Reln r);
+static int cmpPageID(const void *a, const void *b);
+static void releaseExtent(Reln r, PageID b);
+// take all tuples out of bucket b, leaving it one empty page
+static char *collectBucket(Reln r, PageID b, Count *ntups);
+// sorted buckets
+static Status addSorted(Reln r, PageID b, Tuple t);
+static FenceDir *bucketFences(Reln r, PageID b);
+static void resetFences(Reln r, PageID b, PageID pid);
+static void addFence(Reln r, PageID b, PageID pid, Tuple t);
+static void saveFences(Reln r);
+// spiral storage
+static Offset spiralAddr(Count first, HashPos x);
+static PageID spiralPage(Offset a);
+static HashPos spiralLow(Offset a);
+static HashPos spiralHigh(Offset a);
+static HashPos hashPos(HashBits h);
+// extendible hashing
+static void loadDirectory(Reln r);
+static void saveDirectory(Reln r);
+static Bool splitBucket(Reln r, PageID b, HashBits h);
+static Bool nextDirBucket(Reln r, HashBits mask, HashBits val, HashPos *from, PageID *b);
+// add an empty bucket at the end of the file
+static PageID addBucket(Reln r);
+// hot buckets
+static void loadHot(Reln r);
+static void saveHot(Reln r);
+// core info, choice vector and sketches, in the current format
+static void saveInfo(Reln r);
+// #fields in a version 1 .info file
+static Count v1InfoFields(FILE *f, Count nattrs);
+static void makeHot(Reln r, PageID b);
+static void dropHot(Reln r, PageID b);
+static Status addHot(Reln r, PageID b, Tuple t, HashBits h);
+// values moved to rel.lob
+static Tuple spillValues(Reln r, Tuple t);
+
+static PageID insertTuple(Reln r, Tuple t);
+
+static Status finishFreeze(char *name);
 
 // create a new relation (three files)
 
-Status newRelation(char *name, Count nattrs, Count npages, Count d, char *cv)
+// if sortatt >= 0, each bucket is kept ordered on that attribute
+// scheme says how the file grows (see splitSp())
+
+Status newRelation(char *name, Count nattrs, Count npages, Count d, char *cv,
+                   Count layout, int sortatt, Count scheme)
 {
     char fname[MAXFILENAME];
+    // sorted buckets need the row layout
+    if (sortatt >= (int)nattrs || (sortatt >= 0 && layout != ROW_LAYOUT))
+        return ~OK;
     Reln r = malloc(sizeof(struct RelnRep));
     r->nattrs = nattrs; r->depth = d; r->sp = 0;
     r->npages = npages; r->ntups = 0; r->mode = 'w';
-    r->c = 1024/(10*r->nattrs); r->insertion = 0;
-    r->splitting = FALSE;
+    r->c = emptyPageSpace()*FILLPCT/100; r->insertion = 0;
+    r->splitting = FALSE; r->layout = layout; r->frozen = FALSE;
+    r->extent = NULL; r->ebuf = NULL;
+    r->freep = NULL; r->nfree = r->maxfree = 0;
+    r->resv = NULL; r->maxresv = 0;
+    r->sortkey = sortatt + 1;
+    r->scheme = scheme;
+    r->version = INFO_VERSION;
+    r->dir = NULL; r->dirb = NULL; r->maxdirb = 0;
+    r->hot = NULL; r->maxhot = 0;
+    r->fences = NULL; r->maxfences = 0; r->fencef = NULL;
     assert(r != NULL);
+    r->name = copyString(name);
     if (parseChVec(r, cv, r->cv) != OK) return ~OK;
+    r->hll = calloc(nattrs, HLLREGS);
+    assert(r->hll != NULL);
     sprintf(fname,"%s.info",name);
     r->info = fopen(fname,"w");
-    assert(r->info != NULL);
     sprintf(fname,"%s.data",name);
     r->data = fopen(fname,"w");
-    assert(r->data != NULL);
     sprintf(fname,"%s.ovflow",name);
     r->ovflow = fopen(fname,"w");
-    assert(r->ovflow != NULL);
+    if (r->info == NULL || r->data == NULL || r->ovflow == NULL) {
+        // e.g. the directory isn't writable
+        if (r->info != NULL) fclose(r->info);
+        if (r->data != NULL) fclose(r->data);
+        if (r->ovflow != NULL) fclose(r->ovflow);
+        removeRelation(name);
+        free(r->hll); free(r->name); free(r);
+        return ~OK;
+    }
+    sprintf(fname,"%s.lob",name);
+    remove(fname);
+    r->lob = NULL;
     int i;
     for (i = 0; i < npages; i++) addPage(r->data);
+    r->nbstats = npages;
+    r->bstats = malloc(npages*sizeof(BucketStats));
+    assert(r->bstats != NULL);
+    for (i = 0; i < npages; i++) {
+        r->bstats[i].ntuples = 0;
+        r->bstats[i].npages = 1;
+        r->bstats[i].free = emptyPageSpace();
+    }
+    if (scheme == EXTENDIBLE_HASH) {
+        // one bucket per directory entry to start with
+        r->dir = malloc(npages*sizeof(PageID));
+        r->maxdirb = npages;
+        r->dirb = malloc(npages*sizeof(DirBucket));
+        assert(r->dir != NULL && r->dirb != NULL);
+        for (i = 0; i < npages; i++) {
+            r->dir[i] = i;
+            r->dirb[i].ldepth = d;
+            r->dirb[i].nosplit = 0;
+        }
+    }
     closeRelation(r);
     return 0;
 }
 
+// remove all of relation name's files
+
+void removeRelation(char *name)
+{
+    char fname[MAXFILENAME];
+    for (char **f = relnFiles; *f != NULL; f++) {
+        sprintf(fname,"%s.%s",name,*f);
+        remove(fname);
+    }
+    sprintf(fname,"%s.lob",name);
+    remove(fname);
+}
+
 // check whether a relation already exists
 
 Bool existsRelation(char *name)
@@ -77,12 +281,40 @@ Bool existsRelation(char *name)
     }
 }
 
+// #Count fields at the start of a version 1 .info file f, for a
+//   relation with nattrs attributes, or 0 if f isn't one
+// fields were added one at a time (layout, frozen, sortkey, scheme)
+//   before there was a format header, so any number from 8 up to
+//   NINFO may be there; which it is shows in the file's size, with
+//   or without sketches after the choice vector
+// leaves f positioned just after the first two fields
+
+static Count v1InfoFields(FILE *f, Count nattrs)
+{
+    Count k = 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    if (nattrs > 0 && nattrs <= MAXATTRS) {
+        long rest = size - V1CHVEC*sizeof(ChVecItem);
+        for (k = NINFO; k >= 8; k--) {
+            long core = k*sizeof(Count);
+            if (rest == core || rest == core + (long)nattrs*HLLREGS)
+                break;
+        }
+        if (k < 8) k = 0;
+    }
+    fseek(f, 2*sizeof(Count), SEEK_SET);
+    return k;
+}
+
 // set up a relation descriptor from relation name
 // open files, reads information from rel.info
 
 Reln openRelation(char *name, char *mode)
 {
     Reln r;
+    // a freeze that got as far as committing is finished first
+    finishFreeze(name);
     r = malloc(sizeof(struct RelnRep));
     assert(r != NULL);
     char fname[MAXFILENAME];
@@ -95,12 +327,83 @@ Reln openRelation(char *name, char *mode)
     sprintf(fname,"%s.ovflow",name);
     r->ovflow = fopen(fname,mode);
     assert(r->ovflow != NULL);
+    // only relations with large values have one
+    sprintf(fname,"%s.lob",name);
+    r->lob = fopen(fname,mode);
     // Naughty: assumes Count and Offset are the same size
-    int n = fread(r, sizeof(Count), 8, r->info);
-    assert(n == 8);
-    n = fread(r->cv, sizeof(ChVecItem), MAXCHVEC, r->info);
-    assert(n == MAXCHVEC);
+    Count head[2];
+    int n = fread(head, sizeof(Count), 2, r->info);
+    if (n != 2) fatal("Relation's .info file is too short");
+    if (head[0] == INFO_MAGIC) {
+        r->version = head[1];
+        if (r->version != INFO_VERSION)
+            fatal("Relation's .info file has an unknown format version");
+        n = fread(r, sizeof(Count), NINFO, r->info);
+        if (n != NINFO) fatal("Relation's .info file is too short");
+        n = fread(r->cv, sizeof(ChVecItem), MAXCHVEC, r->info);
+        if (n != MAXCHVEC) fatal("Relation's .info file is too short");
+    }
+    else {
+        // version 1: the header was nattrs and depth
+        Count k = v1InfoFields(r->info, head[0]);
+        if (k == 0) fatal("Relation's .info file is in an unknown format");
+        r->version = 1;
+        // fields it doesn't have are all off (row layout, not
+        //   frozen, unsorted, linear hashing)
+        memset(r, 0, NINFO*sizeof(Count));
+        memcpy(r, head, sizeof(head));
+        n = fread((Count *)r + 2, sizeof(Count), k-2, r->info);
+        assert(n == k-2);
+        n = fread(r->cv, sizeof(ChVecItem), V1CHVEC, r->info);
+        assert(n == V1CHVEC);
+        // its tuples are placed by the low V1CHVEC bits only
+        extendChVec(r->cv, V1CHVEC, r->nattrs);
+    }
+    // attribute sketches follow the choice vector
+    // (relations created without them start with empty sketches)
+    r->hll = calloc(r->nattrs, HLLREGS);
+    assert(r->hll != NULL);
+    n = fread(r->hll, HLLREGS, r->nattrs, r->info);
+    if (n != r->nattrs) memset(r->hll, 0, r->nattrs*HLLREGS);
     r->mode = (mode[0] == 'w' || mode[1] =='+') ? 'w' : 'r';
+    r->name = copyString(name);
+    // updates must keep the bucket counters in step
+    r->bstats = NULL;
+    r->extent = NULL; r->ebuf = NULL;
+    r->freep = NULL; r->nfree = r->maxfree = 0;
+    r->resv = NULL; r->maxresv = 0;
+    r->fences = NULL; r->maxfences = 0; r->fencef = NULL;
+    r->dir = NULL; r->dirb = NULL; r->maxdirb = 0;
+    if (r->scheme == EXTENDIBLE_HASH) loadDirectory(r);
+    r->hot = NULL; r->maxhot = 0;
+    // version 1 hot buckets are segmented on bits that have moved,
+    //   but their chains can still be read straight through
+    if (r->version == INFO_VERSION) loadHot(r);
+    // old formats can't be updated until upgradeRelation()
+    if (r->version != INFO_VERSION && r->mode == 'w') {
+        r->mode = 'r';
+        closeRelation(r);
+        return NULL;
+    }
+    if (r->frozen) {
+        // frozen relations can't be updated
+        if (r->mode == 'w') {
+            r->mode = 'r';
+            closeRelation(r);
+            return NULL;
+        }
+        // the overflow file holds the extent offsets
+        r->extent = malloc((r->npages+1)*sizeof(Offset));
+        assert(r->extent != NULL);
+        n = fread(r->extent, sizeof(Offset), r->npages+1, r->ovflow);
+        assert(n == r->npages+1);
+    }
+    if (r->mode == 'w') {
+        bucketStats(r);
+        loadFreeList(r);
+        // relations made when c counted tuples get the byte count
+        r->c = emptyPageSpace()*FILLPCT/100;
+    }
     return r;
 }
 
@@ -112,66 +415,346 @@ void closeRelation(Reln r)
     // make sure updated global data is put in info
     // Naughty: assumes Count and Offset are the same size
     if (r->mode == 'w') {
-        fseek(r->info, 0, SEEK_SET);
-        // write out core relation info (#attr,#pages,d,sp)
-        int n = fwrite(r, sizeof(Count), 8, r->info);
-        assert(n == 8);
-        // write out choice vector
-        n = fwrite(r->cv, sizeof(ChVecItem), MAXCHVEC, r->info);
-        assert(n == MAXCHVEC);
+        saveInfo(r);
+        // write out bucket counters, preceded by the #buckets and
+        //   #tuples they are for
+        char fname[MAXFILENAME];
+        sprintf(fname,"%s.bstats",r->name);
+        FILE *f = fopen(fname,"w");
+        int n;
+        assert(f != NULL);
+        Count head[3] = { BSTATS_MAGIC, r->npages, r->ntups };
+        n = fwrite(head, sizeof(Count), 3, f);
+        n += fwrite(r->bstats, sizeof(BucketStats), r->npages, f);
+        assert(n == r->npages+3);
+        fclose(f);
+        // write out free overflow pages, preceded by their number
+        sprintf(fname,"%s.free",r->name);
+        f = fopen(fname,"w");
+        assert(f != NULL);
+        n = fwrite(&r->nfree, sizeof(Count), 1, f);
+        n += fwrite(r->freep, sizeof(PageID), r->nfree, f);
+        assert(n == r->nfree+1);
+        // and each bucket's reserved pages
+        n = fwrite(&r->maxresv, sizeof(Count), 1, f);
+        n += fwrite(r->resv, sizeof(OvExtent), r->maxresv, f);
+        assert(n == r->maxresv+1);
+        fclose(f);
+        if (r->fences != NULL) saveFences(r);
+        if (r->dir != NULL) saveDirectory(r);
+        saveHot(r);
     }
     fclose(r->info);
     fclose(r->data);
     fclose(r->ovflow);
+    if (r->lob != NULL) fclose(r->lob);
+    free(r->hll);
+    free(r->bstats);
+    free(r->freep);
+    free(r->resv);
+    if (r->fences != NULL) {
+        for (Count b = 0; b < r->maxfences; b++) free(r->fences[b].f);
+        free(r->fences);
+    }
+    if (r->fencef != NULL) fclose(r->fencef);
+    free(r->extent);
+    free(r->ebuf);
+    free(r->dir);
+    free(r->dirb);
+    for (Count b = 0; b < r->maxhot; b++) free(r->hot[b]);
+    free(r->hot);
+    free(r->name);
     free(r);
 }
 
+static void saveInfo(Reln r)
+{
+    fseek(r->info, 0, SEEK_SET);
+    // write out format header
+    Count head[2] = { INFO_MAGIC, INFO_VERSION };
+    int n = fwrite(head, sizeof(Count), 2, r->info);
+    assert(n == 2);
+    // write out core relation info (#attr,#pages,d,sp)
+    n = fwrite(r, sizeof(Count), NINFO, r->info);
+    assert(n == NINFO);
+    // write out choice vector
+    n = fwrite(r->cv, sizeof(ChVecItem), MAXCHVEC, r->info);
+    assert(n == MAXCHVEC);
+    // write out attribute sketches
+    n = fwrite(r->hll, HLLREGS, r->nattrs, r->info);
+    assert(n == r->nattrs);
+}
+
+// rewrite an old format relation's .info file in the current format
+// - the choice vector's new bits come after the old ones, so every
+//   tuple stays in its bucket
+// - hot bucket segments are forgotten; each is rebuilt the next
+//   time its bucket is inserted into
+// returns OK, or ~OK if the relation can't be opened
+
+Status upgradeRelation(char *name)
+{
+    Reln r = openRelation(name, "r");
+    if (r == NULL) return ~OK;
+    if (r->version != INFO_VERSION) {
+        char fname[MAXFILENAME];
+        sprintf(fname,"%s.info",name);
+        fclose(r->info);
+        r->info = fopen(fname,"r+");
+        assert(r->info != NULL);
+        saveInfo(r);
+        saveHot(r);
+    }
+    closeRelation(r);
+    return OK;
+}
+
+// rewrite a relation in the read-only frozen format
+// - each bucket's tuples are packed into as few pages as possible,
+//   which are stored together as one extent of the data file
+// - pages in an extent are chained as before, but via data PageIDs
+// - the overflow file is replaced by the extent offsets, so any
+//   bucket can be fetched with one sequential read
+// returns OK, or ~OK if the new files can't be written
+
+Status freezeRelation(char *name)
+{
+    Reln r = openRelation(name, "r");
+    if (r == NULL) return ~OK;
+    if (r->frozen) {
+        closeRelation(r);
+        return OK;
+    }
+    // the frozen relation is built as relation name.frz, then its
+    //   files replace name's (see finishFreeze()); until then a
+    //   crash leaves name as it was
+    char fname[MAXFILENAME+16], dname[MAXFILENAME+16], oname[MAXFILENAME+16];
+    for (char **f = relnFiles; *f != NULL; f++) {
+        sprintf(fname,"%s.frz.%s",name,*f);
+        remove(fname);
+    }
+    sprintf(dname,"%s.frz.data",name);
+    sprintf(oname,"%s.frz.ovflow",name);
+    FILE *data = fopen(dname,"w");
+    FILE *ovflow = fopen(oname,"w");
+    if (data == NULL || ovflow == NULL) {
+        if (data != NULL) fclose(data);
+        if (ovflow != NULL) fclose(ovflow);
+        closeRelation(r);
+        return ~OK;
+    }
+
+    // addTuple() and noteNewPage() keep counters for the new pages
+    r->nbstats = r->npages;
+    r->bstats = malloc(r->npages*sizeof(BucketStats));
+    assert(r->bstats != NULL);
+    r->extent = malloc((r->npages+1)*sizeof(Offset));
+    assert(r->extent != NULL);
+    PageID next = 0;
+    PageScan scan;
+    Tuple t;
+    for (PageID b = 0; b < r->npages; b++) {
+        r->extent[b] = next;
+        r->bstats[b].ntuples = 0;
+        r->bstats[b].npages = 1;
+        r->bstats[b].free = emptyPageSpace();
+        if (r->sortkey) resetFences(r, b, next);
+        // frozen buckets are packed in tuple order
+        dropHot(r, b);
+        Page out = newPage();
+        Page p;
+        for (p = firstBucketPage(r, b); p != NULL; p = nextBucketPage(r, p)) {
+            startPageScan(&scan, p, r->nattrs, r->layout);
+            while ((t = nextPageTuple(&scan)) != NULL) {
+                if (addTuple(r, b, out, t) == OK) continue;
+                pageSetOvflow(out, next+1);
+                putPage(data, next++, out);
+                out = newPage();
+                noteNewPage(r, b);
+                if (r->sortkey) addFence(r, b, next, t);
+                Status ok = addTuple(r, b, out, t);
+                assert(ok == OK);
+            }
+        }
+        putPage(data, next++, out);
+    }
+    r->extent[r->npages] = next;
+    int n = fwrite(r->extent, sizeof(Offset), r->npages+1, ovflow);
+    assert(n == r->npages+1);
+    fclose(data);
+    fclose(ovflow);
+
+    // save the new info and counters as name.frz's
+    sprintf(fname,"%s.frz.info",name);
+    fclose(r->info);
+    r->info = fopen(fname,"w");
+    if (r->info == NULL) {
+        r->info = fopen("/dev/null","r");
+        closeRelation(r);
+        return ~OK;
+    }
+    free(r->name);
+    sprintf(fname,"%s.frz",name);
+    r->name = copyString(fname);
+    r->frozen = TRUE;
+    r->mode = 'w';
+    closeRelation(r);
+    // an empty name.frz file stands for one the frozen relation
+    //   doesn't have (e.g. rel.hot), so that name's old one goes
+    for (char **f = relnFiles; *f != NULL; f++) {
+        sprintf(fname,"%s.frz.%s",name,*f);
+        FILE *e = fopen(fname,"r");
+        if (e == NULL) e = fopen(fname,"w");
+        if (e == NULL) return ~OK;
+        fclose(e);
+    }
+
+    // commit, then switch to the new files
+    sprintf(dname,"%s.frz.info",name);
+    sprintf(fname,"%s.frz.commit",name);
+    if (rename(dname, fname) != 0) return ~OK;
+    return finishFreeze(name);
+}
+
+// finish switching relation name to the files of its frozen copy
+//   name.frz, once freezeRelation() has committed to it by renaming
+//   name.frz.info to name.frz.commit
+// the other files are moved over name's first, and name.info last;
+//   an empty one means name's is removed instead; doing it again
+//   after a crash part-way through is harmless
+// returns OK if there was nothing to do, or it's done
+
+static Status finishFreeze(char *name)
+{
+    char from[MAXFILENAME+16], to[MAXFILENAME+16];
+    sprintf(from,"%s.frz.commit",name);
+    FILE *f = fopen(from,"r");
+    if (f == NULL) return OK;
+    fclose(f);
+    for (char **s = relnFiles; *s != NULL; s++) {
+        if (strcmp(*s, "info") == 0) continue;
+        sprintf(from,"%s.frz.%s",name,*s);
+        sprintf(to,"%s.%s",name,*s);
+        if ((f = fopen(from,"r")) == NULL) continue;
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fclose(f);
+        if (size == 0) {
+            remove(to);
+            remove(from);
+        }
+        else if (rename(from, to) != 0)
+            return ~OK;
+    }
+    sprintf(from,"%s.frz.commit",name);
+    sprintf(to,"%s.info",name);
+    return rename(from, to) == 0 ? OK : ~OK;
+}
+
 // insert a new tuple into a relation
 // returns index of bucket where inserted
 // - index always refers to a primary data page
 // - the actual insertion page may be either a data page or an overflow page
 // returns NO_PAGE if insert fails completely
+// the insert is recorded in the trace, if there is one
 
 PageID addToRelation(Reln r, Tuple t)
 {
-    // if c tuples inserted after last split, split again
+    if (!tracing()) return insertTuple(r, t);
+    double start = traceClock();
+    PageID p = insertTuple(r, t);
+    if (p != NO_PAGE) traceInsert(r->name, t, start);
+    return p;
+}
+
+// insert a tuple, as for addToRelation(), without recording it
+// (tuples moved by splits aren't new inserts)
+
+static PageID insertTuple(Reln r, Tuple t)
+{
+    // if c bytes inserted after last split, split again
+    // (counting bytes keeps pages about FILLPCT% full, whatever
+    //   size the tuples are)
     // change reln status to split, 
     // when insert tuples in sp, insertion will not be counted 
     // in ntups and insertions.
-    if (r->insertion == r->c) {
+    if (r->insertion >= r->c && r->scheme != EXTENDIBLE_HASH) {
         r->insertion = 0;
         r->splitting = TRUE;
         splitSp(r);
         r->splitting = FALSE;
     }
+    // a tuple too long for a page has values moved to rel.lob
+    if (!r->splitting && tupLength(t) > pageMaxTuple(r->nattrs, r->layout)) {
+        Tuple s = spillValues(r, t);
+        if (s == NULL) return NO_PAGE;
+        PageID p = insertTuple(r, s);
+        free(s);
+        return p;
+    }
     
-    Bits h, p;
-    h = tupleHash(r,t);
-    p = getLower(h, r->depth);
-    if (p < r->sp) p = getLower(h, r->depth+1);
+    HashBits h;
+    Bits p, hashVals[MAXATTRS];
+    h = tupleAttrHash(r,t,hashVals);
+    // count each attribute value once; not again when split moves it
+    if (!r->splitting) {
+        for (Count a = 0; a < r->nattrs; a++)
+            hllAdd(r->hll + a*HLLREGS, hashVals[a]);
+    }
+    p = hashBucket(r, h);
+    // extendible hashing splits a bucket when it fills up
+    // (bstats says so without reading the page)
+    if (r->scheme == EXTENDIBLE_HASH && !r->splitting) {
+        BucketStats *bs = &r->bstats[p];
+        if ((bs->npages > 1 || bs->free < strlen(t) + 1)
+            && bs->ntuples >= r->dirb[p].nosplit && splitBucket(r, p, h))
+            p = hashBucket(r, h);
+    }
+    // sorted buckets put the tuple in its place in key order
+    if (r->sortkey) {
+        if (addSorted(r, p, t) != OK) return NO_PAGE;
+        if (!r->splitting) {
+            r->ntups++;
+            r->insertion += tupLength(t) + 1;
+        }
+        return p;
+    }
+    // a long chain is made hot, and split into segments
+    // (splitSp() only refills chains in place if they are shorter)
+    if (!r->frozen && r->bstats[p].npages >= HOTCHAIN && !hotBucket(r, p))
+        makeHot(r, p);
+    if (hotBucket(r, p)) {
+        if (addHot(r, p, t, h) != OK) return NO_PAGE;
+        if (!r->splitting) {
+            r->ntups++;
+            r->insertion += tupLength(t) + 1;
+        }
+        return p;
+    }
     // insert in primary data page
     Page pg = getPage(r->data,p);
-    if (addToPage(pg,t) == OK) {
+    if (addTuple(r,p,pg,t) == OK) {
         putPage(r->data,p,pg);
         if (!r->splitting) {
             r->ntups++;
-            r->insertion++;
+            r->insertion += tupLength(t) + 1;
         }
         return p;
     }
     // primary data page full
     if (pageOvflow(pg) == NO_PAGE) {
         // add first overflow page in chain
-        PageID newp = addPage(r->ovflow);
+        PageID newp = newOvflowPage(r, p);
+        noteNewPage(r, p);
         pageSetOvflow(pg,newp);
         putPage(r->data,p,pg);
         Page newpg = getPage(r->ovflow,newp);
         // can't add to a new page; we have a problem
-        if (addToPage(newpg,t) != OK) return NO_PAGE;
+        if (addTuple(r,p,newpg,t) != OK) return NO_PAGE;
         putPage(r->ovflow,newp,newpg);
         if (!r->splitting) {
             r->ntups++;
-            r->insertion++;
+            r->insertion += tupLength(t) + 1;
         }
         return p;
     } else {
@@ -182,7 +765,8 @@ PageID addToRelation(Reln r, Tuple t)
         ovp = pageOvflow(pg);
         while (ovp != NO_PAGE) {
             ovpg = getPage(r->ovflow, ovp);
-            if (addToPage(ovpg,t) != OK) {
+            if (addTuple(r,p,ovpg,t) != OK) {
+                if (prevpg != NULL) free(prevpg);
                 prevp = ovp; prevpg = ovpg;
                 ovp = pageOvflow(ovpg);
             } else {
@@ -190,7 +774,7 @@ PageID addToRelation(Reln r, Tuple t)
                 putPage(r->ovflow,ovp,ovpg);
                 if (!r->splitting) {
                     r->ntups++;
-                    r->insertion++;
+                    r->insertion += tupLength(t) + 1;
                 }
                 return p;
             }
@@ -199,49 +783,582 @@ PageID addToRelation(Reln r, Tuple t)
         // at this point, there *must* be a prevpg
         assert(prevpg != NULL);
         // make new ovflow page
-        PageID newp = addPage(r->ovflow);
+        PageID newp = newOvflowPage(r, p);
+        noteNewPage(r, p);
         // insert tuple into new page
         Page newpg = getPage(r->ovflow,newp);
-        if (addToPage(newpg,t) != OK) return NO_PAGE;
+        if (addTuple(r,p,newpg,t) != OK) return NO_PAGE;
         putPage(r->ovflow,newp,newpg);
         // link to existing overflow chain
         pageSetOvflow(prevpg,newp);
         putPage(r->ovflow,prevp,prevpg);
         if (!r->splitting) {
             r->ntups++;
-            r->insertion++;
+            r->insertion += tupLength(t) + 1;
         }
         return p;
     }
 }
 
+static Status addTuple(Reln r, PageID b, Page p, Tuple t)
+{
+    Count before = pageFreeSpace(p);
+    Status ok;
+    if (r->sortkey)
+        ok = addToSortedPage(p, t, r->sortkey-1);
+    else if (r->layout == PAX_LAYOUT)
+        ok = addToPaxPage(p, t, r->nattrs);
+    else
+        ok = addToPage(p, t);
+    if (ok == OK) {
+        r->bstats[b].ntuples++;
+        r->bstats[b].free -= before - pageFreeSpace(p);
+    }
+    return ok;
+}
+
+static void noteNewPage(Reln r, PageID b)
+{
+    r->bstats[b].npages++;
+    r->bstats[b].free += emptyPageSpace();
+}
+
+static Count emptyPageSpace()
+{
+    Page p = newPage();
+    Count n = pageFreeSpace(p);
+    free(p);
+    return n;
+}
+
+// free overflow pages are kept as a list of PageIDs in rel.free
+// a free page is always empty on disk, ready for reuse
+// rel.free also holds each bucket's extent of reserved pages
+
+static void loadFreeList(Reln r)
+{
+    char fname[MAXFILENAME];
+    sprintf(fname,"%s.free",r->name);
+    FILE *f = fopen(fname,"r");
+    if (f == NULL) return;
+    Count n;
+    if (fread(&n, sizeof(Count), 1, f) == 1 && n > 0) {
+        r->freep = malloc(n*sizeof(PageID));
+        assert(r->freep != NULL);
+        r->maxfree = n;
+        r->nfree = fread(r->freep, sizeof(PageID), n, f);
+        // sorted once here, then kept sorted by freeOvflowPage()
+        qsort(r->freep, r->nfree, sizeof(PageID), cmpPageID);
+    }
+    if (fread(&n, sizeof(Count), 1, f) == 1 && n > 0) {
+        r->resv = calloc(n, sizeof(OvExtent));
+        assert(r->resv != NULL);
+        r->maxresv = n;
+        if (fread(r->resv, sizeof(OvExtent), n, f) != n)
+            memset(r->resv, 0, n*sizeof(OvExtent));
+    }
+    fclose(f);
+}
+
+// next overflow page for bucket b's chain
+// pages come from an extent reserved for the bucket, so that a
+//   chain is made of a few runs of consecutive pages, rather than
+//   pages interleaved with other chains
+// extents double with the chain, up to OVEXTENT pages, so short
+//   chains don't tie up much space
+
+static PageID newOvflowPage(Reln r, PageID b)
+{
+    if (b >= r->maxresv) {
+        Count n = r->maxresv == 0 ? r->npages : r->maxresv;
+        while (n <= b) n *= 2;
+        r->resv = realloc(r->resv, n*sizeof(OvExtent));
+        assert(r->resv != NULL);
+        memset(&r->resv[r->maxresv], 0, (n-r->maxresv)*sizeof(OvExtent));
+        r->maxresv = n;
+    }
+    OvExtent *e = &r->resv[b];
+    if (e->n == 0) {
+        Count k = r->bstats[b].npages;
+        if (k > OVEXTENT) k = OVEXTENT;
+        if (k < 2) k = 2;
+        e->next = newOvflowRun(r, k);
+        e->n = k;
+    }
+    e->n--;
+    return e->next++;
+}
+
+// return bucket b's unused reserved pages to the free list
+
+static void releaseExtent(Reln r, PageID b)
+{
+    if (b >= r->maxresv) return;
+    OvExtent *e = &r->resv[b];
+    while (e->n > 0) {
+        freeOvflowPage(r, e->next++);
+        e->n--;
+    }
+}
+
+// the free list is kept sorted in descending order, so that single
+//   pages are handed out low-numbered first, and runs are easy to find
+
+static void freeOvflowPage(Reln r, PageID pid)
+{
+    putPage(r->ovflow, pid, newPage());
+    if (r->nfree == r->maxfree) {
+        r->maxfree = r->maxfree == 0 ? 64 : 2*r->maxfree;
+        r->freep = realloc(r->freep, r->maxfree*sizeof(PageID));
+        assert(r->freep != NULL);
+    }
+    // binary search for the first entry below pid
+    Count lo = 0, hi = r->nfree;
+    while (lo < hi) {
+        Count mid = (lo + hi)/2;
+        if (r->freep[mid] > pid) lo = mid+1; else hi = mid;
+    }
+    memmove(&r->freep[lo+1], &r->freep[lo], (r->nfree-lo)*sizeof(PageID));
+    r->freep[lo] = pid;
+    r->nfree++;
+}
+
+static int cmpPageID(const void *a, const void *b)
+{
+    PageID p1 = *(const PageID *)a, p2 = *(const PageID *)b;
+    return p1 > p2 ? -1 : p1 < p2;
+}
+
+// k consecutive overflow pages: the lowest run of free pages
+//   if there is one, otherwise k new pages at the end of the file
+
+static PageID newOvflowRun(Reln r, Count k)
+{
+    if (k == 1 && r->nfree > 0) return r->freep[--r->nfree];
+    // scan up from the lowest free page (at the end of the list)
+    Count i, j;
+    for (i = r->nfree; i >= k; i = j) {
+        for (j = i-1; j > i-k && r->freep[j-1] == r->freep[j]+1; j--)
+            ;
+        if (j == i-k) break;
+    }
+    if (i >= k) {
+        PageID first = r->freep[i-1];
+        memmove(&r->freep[i-k], &r->freep[i],
+                (r->nfree-i)*sizeof(PageID));
+        r->nfree -= k;
+        return first;
+    }
+    PageID first = addPage(r->ovflow);
+    for (i = 1; i < k; i++) addPage(r->ovflow);
+    return first;
+}
+
+// rewrite bucket b with its tuples packed into as few pages as
+//   possible, and its overflow pages consecutive in rel.ovflow
+// the old overflow pages go on the free list
+// returns ~OK if r isn't open for writing
+
+Status vacuumBucket(Reln r, PageID b)
+{
+    if (r->mode != 'w' || b >= r->npages) return ~OK;
+    Count ntups;
+    char *tups = collectBucket(r, b, &ntups);
+
+    // pack them into new pages, keeping the counters right
+    // start[i] is the first tuple in page i
+    Count npg = 1, maxpg = 8;
+    Page *pg = malloc(maxpg*sizeof(Page));
+    char **start = malloc(maxpg*sizeof(char *));
+    assert(pg != NULL && start != NULL);
+    pg[0] = newPage();
+    char *c = tups;
+    for (Count i = 0; i < ntups; i++, c += strlen(c) + 1) {
+        if (addTuple(r, b, pg[npg-1], c) == OK) continue;
+        if (npg == maxpg) {
+            maxpg *= 2;
+            pg = realloc(pg, maxpg*sizeof(Page));
+            start = realloc(start, maxpg*sizeof(char *));
+            assert(pg != NULL && start != NULL);
+        }
+        start[npg] = c;
+        pg[npg++] = newPage();
+        noteNewPage(r, b);
+        Status ok = addTuple(r, b, pg[npg-1], c);
+        assert(ok == OK);
+    }
+
+    // primary page, then the rest on a run of overflow pages
+    PageID first = npg > 1 ? newOvflowRun(r, npg-1) : NO_PAGE;
+    for (Count i = 0; i < npg; i++) {
+        pageSetOvflow(pg[i], i+1 < npg ? first+i : NO_PAGE);
+        if (i == 0)
+            putPage(r->data, b, pg[i]);
+        else {
+            if (r->sortkey) addFence(r, b, first+i-1, start[i]);
+            putPage(r->ovflow, first+i-1, pg[i]);
+        }
+    }
+    free(tups);
+    free(start);
+    free(pg);
+    return OK;
+}
+
+// copy the tuples of bucket b, '\0'-separated and in chain order,
+//   into a new buffer, and leave the bucket as one empty page
+// its overflow pages (used or reserved) go on the free list
+
+static char *collectBucket(Reln r, PageID b, Count *ntups)
+{
+    char *tups = NULL;
+    Count used = 0, size = 0;
+    PageScan scan;
+    Tuple t;
+    Page p = getPage(r->data, b);
+    PageID pid = NO_PAGE;
+    *ntups = 0;
+    releaseExtent(r, b);
+    while (p != NULL) {
+        startPageScan(&scan, p, r->nattrs, r->layout);
+        while ((t = nextPageTuple(&scan)) != NULL) {
+            Count len = strlen(t) + 1;
+            if (used + len > size) {
+                size = size == 0 ? 4*PAGESIZE : 2*size;
+                if (size < used + len) size = used + len;
+                tups = realloc(tups, size);
+                assert(tups != NULL);
+            }
+            memcpy(tups + used, t, len);
+            used += len;
+            (*ntups)++;
+        }
+        PageID next = pageOvflow(p);
+        free(p);
+        if (pid != NO_PAGE) freeOvflowPage(r, pid);
+        pid = next;
+        p = pid == NO_PAGE ? NULL : getPage(r->ovflow, pid);
+    }
+    putPage(r->data, b, newPage());
+    dropHot(r, b);
+    r->bstats[b].ntuples = 0;
+    r->bstats[b].npages = 1;
+    r->bstats[b].free = emptyPageSpace();
+    if (r->sortkey) resetFences(r, b, b);
+    return tups;
+}
+
+// #free overflow pages
+
+Count freeOvflowPages(Reln r) { return r->nfree; }
+
+// Sorted buckets
+// - the tuples of a bucket are kept in order on the sort attribute,
+//   along the whole chain: each page's tuples are ordered, and come
+//   after those of the page before it
+// - each bucket has a fence directory, holding for each page of the
+//   chain its PageID and (a prefix of) its first key, so a lookup
+//   can binary-search for the pages that may hold a key
+// - a full page is split in two, the upper half going to a new
+//   overflow page linked in after it
+// - the directories are kept in rel.fence, after a table of where
+//   each bucket's entries start, so that a lookup only needs to
+//   read one bucket's directory
+// - if rel.fence is missing or out of date, all the directories
+//   are rebuilt from the pages
+
+// compare a fence key with (the same prefix of) key
+
+static int fenceCmp(char *fkey, char *key, int klen)
+{
+    if (klen > FENCELEN-1) klen = FENCELEN-1;
+    return compareVals(fkey, strlen(fkey), key, klen);
+}
+
+// index of the last fence in d that is < key (if strict) or <= key
+// the primary page's fence is "", so the result is at least 0
+
+static Count lastFence(FenceDir *d, char *key, int klen, Bool strict)
+{
+    Count lo = 0, hi = d->n;   // answer is in lo..hi-1
+    while (hi - lo > 1) {
+        Count mid = (lo + hi)/2;
+        int cmp = fenceCmp(d->f[mid].key, key, klen);
+        if (cmp < 0 || (!strict && cmp == 0))
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// bucket b's directory becomes just its primary page pid
+
+static void resetFences(Reln r, PageID b, PageID pid)
+{
+    FenceDir *d = bucketFences(r, b);
+    d->loaded = TRUE;
+    d->n = 0;
+    addFence(r, b, pid, NULL);
+}
+
+// add page pid, whose first tuple is t, at the end of b's directory
+// t is NULL for the primary page
+
+static void addFence(Reln r, PageID b, PageID pid, Tuple t)
+{
+    FenceDir *d = bucketFences(r, b);
+    if (d->n == d->max) {
+        d->max = d->max == 0 ? 2 : 2*d->max;
+        d->f = realloc(d->f, d->max*sizeof(Fence));
+        assert(d->f != NULL);
+    }
+    Fence *f = &d->f[d->n++];
+    f->pid = pid;
+    f->key[0] = '\0';
+    if (t != NULL) {
+        int len;
+        char *v = tupleAttr(t, r->sortkey-1, &len);
+        if (len > FENCELEN-1) len = FENCELEN-1;
+        memcpy(f->key, v, len);
+        f->key[len] = '\0';
+    }
+}
+
+// rebuild bucket b's directory from its pages
+
+static void scanFences(Reln r, PageID b)
+{
+    PageScan scan;
+    PageID pid = r->frozen ? r->extent[b] : b;
+    resetFences(r, b, pid);
+    Page p = firstBucketPage(r, b);
+    while ((pid = pageOvflow(p)) != NO_PAGE) {
+        p = nextBucketPage(r, p);
+        startPageScan(&scan, p, r->nattrs, r->layout);
+        addFence(r, b, pid, nextPageTuple(&scan));
+    }
+    free(p);
+}
+
+// fence directory of bucket b, loaded from rel.fence if need be
+
+static FenceDir *bucketFences(Reln r, PageID b)
+{
+    assert(r->sortkey);
+    if (r->fences == NULL) {
+        r->maxfences = r->npages;
+        r->fences = calloc(r->maxfences, sizeof(FenceDir));
+        assert(r->fences != NULL);
+        char fname[MAXFILENAME];
+        sprintf(fname,"%s.fence",r->name);
+        r->fencef = fopen(fname,"r");
+        r->nfencef = 0;
+        if (r->fencef != NULL &&
+            (fread(&r->nfencef, sizeof(Count), 1, r->fencef) != 1 ||
+             r->nfencef != r->npages)) {
+            fclose(r->fencef);
+            r->fencef = NULL;
+        }
+        if (r->fencef == NULL) {
+            r->nfencef = 0;
+            for (PageID i = 0; i < r->npages; i++) scanFences(r, i);
+        }
+    }
+    FenceDir *d = b < r->maxfences ? &r->fences[b] : NULL;
+    if (d != NULL && !d->loaded && b < r->nfencef) {
+        Count at[2];
+        fseek(r->fencef, (1+b)*sizeof(Count), SEEK_SET);
+        int n = fread(at, sizeof(Count), 2, r->fencef);
+        assert(n == 2);
+        d->n = d->max = at[1] - at[0];
+        d->f = malloc(d->n*sizeof(Fence));
+        assert(d->f != NULL);
+        fseek(r->fencef, (2+r->nfencef)*sizeof(Count) + at[0]*sizeof(Fence),
+              SEEK_SET);
+        n = fread(d->f, sizeof(Fence), d->n, r->fencef);
+        assert(n == d->n);
+        d->loaded = TRUE;
+    }
+    if (b >= r->maxfences) {
+        Count n = r->maxfences;
+        while (n <= b) n *= 2;
+        r->fences = realloc(r->fences, n*sizeof(FenceDir));
+        assert(r->fences != NULL);
+        memset(&r->fences[r->maxfences], 0, (n-r->maxfences)*sizeof(FenceDir));
+        r->maxfences = n;
+    }
+    return &r->fences[b];
+}
+
+static void saveFences(Reln r)
+{
+    PageID b;
+    // everything must be in memory before rel.fence is rewritten
+    for (b = 0; b < r->npages; b++) bucketFences(r, b);
+    if (r->fencef != NULL) fclose(r->fencef);
+    r->fencef = NULL;
+    char fname[MAXFILENAME];
+    sprintf(fname,"%s.fence",r->name);
+    FILE *f = fopen(fname,"w");
+    assert(f != NULL);
+    int n = fwrite(&r->npages, sizeof(Count), 1, f);
+    Count at = 0;
+    for (b = 0; b <= r->npages; b++) {
+        n += fwrite(&at, sizeof(Count), 1, f);
+        if (b < r->npages) at += r->fences[b].n;
+    }
+    assert(n == r->npages+2);
+    for (b = 0; b < r->npages; b++) {
+        FenceDir *d = &r->fences[b];
+        n = fwrite(d->f, sizeof(Fence), d->n, f);
+        assert(n == d->n);
+    }
+    fclose(f);
+}
+
+// insert tuple t in its place in sorted bucket b
+
+static Status addSorted(Reln r, PageID b, Tuple t)
+{
+    FenceDir *d = bucketFences(r, b);
+    int klen;
+    char *key = tupleAttr(t, r->sortkey-1, &klen);
+    Count i = lastFence(d, key, klen, FALSE);
+    PageID pid = d->f[i].pid;
+    FILE *f = i == 0 ? r->data : r->ovflow;
+    Page p = getPage(f, pid);
+    if (addTuple(r, b, p, t) == OK) {
+        putPage(f, pid, p);
+        return OK;
+    }
+
+    // page is full; gather its tuples and t, in order, and
+    //   put the lower half (by size) back, the rest in a new page
+    char *tups[PAGESIZE/2];
+    Count n = 0, total = 0, j;
+    PageScan scan;
+    Tuple tup;
+    int len;
+    Bool placed = FALSE;
+    startPageScan(&scan, p, r->nattrs, r->layout);
+    while ((tup = nextPageTuple(&scan)) != NULL) {
+        char *v = tupleAttr(tup, r->sortkey-1, &len);
+        if (!placed && compareVals(v, len, key, klen) > 0) {
+            tups[n++] = t;
+            placed = TRUE;
+        }
+        tups[n++] = tup;
+    }
+    if (!placed) tups[n++] = t;
+    for (j = 0; j < n; j++) total += strlen(tups[j]) + 1;
+
+    PageID newp = newOvflowPage(r, b);
+    noteNewPage(r, b);
+    // the lower half replaces p
+    r->bstats[b].ntuples -= pageNTuples(p);
+    r->bstats[b].free += emptyPageSpace() - pageFreeSpace(p);
+    Page lo = newPage(), hi = newPage();
+    Count used = 0;
+    for (j = 0; j < n; j++) {
+        Count size = strlen(tups[j]) + 1;
+        if (j > 0 && (j == n-1 || used + size > total/2)) break;
+        Status ok = addTuple(r, b, lo, tups[j]);
+        assert(ok == OK);
+        used += size;
+    }
+    // new page goes after p in the chain and the directory
+    addFence(r, b, newp, tups[j]);
+    Fence nf = d->f[d->n-1];
+    memmove(&d->f[i+2], &d->f[i+1], (d->n-i-2)*sizeof(Fence));
+    d->f[i+1] = nf;
+    for (; j < n; j++) {
+        Status ok = addTuple(r, b, hi, tups[j]);
+        if (ok != OK) return ~OK;
+    }
+    pageSetOvflow(hi, pageOvflow(p));
+    pageSetOvflow(lo, newp);
+    free(p);
+    putPage(f, pid, lo);
+    putPage(r->ovflow, newp, hi);
+    return OK;
+}
+
+// attribute that buckets are sorted on, or -1
+
+int sortAttr(Reln r) { return (int)r->sortkey - 1; }
+
+// first page of sorted bucket b that may hold tuples with key as
+//   their sort attribute; *npages is set to the number of pages,
+//   from that one on, that may hold them
+// the rest of those pages come from nextBucketPage()
+
+Page seekBucketPage(Reln r, PageID b, char *key, Count *npages)
+{
+    FenceDir *d = bucketFences(r, b);
+    int klen = strlen(key);
+    Count first = lastFence(d, key, klen, TRUE);
+    Count last = lastFence(d, key, klen, FALSE);
+    *npages = last - first + 1;
+    PageID pid = d->f[first].pid;
+    if (first == 0 && !r->frozen) return firstBucketPage(r, b);
+    return getPage(r->frozen ? r->data : r->ovflow, pid);
+}
+
+// grow the file by one bucket, moving some tuples into it
+// linear hashing splits the bucket at sp, whose tuples are spread
+//   over it and its buddy at sp+2^d
+// spiral storage splits the first logical bucket, n (for a file of
+//   n buckets), whose tuples are spread over 2n and 2n+1; these are
+//   stored in n's old bucket and the new one
+
 static void splitSp(Reln r)
 {
+    PageID old = r->scheme == SPIRAL_HASH ? spiralPage(r->npages) : r->sp;
     // add new buddy page at sp+2^d-1 offset,
-    addPage(dataFile(r));
-    r->npages++;
+    addBucket(r);
+    BucketStats *bs;
+    if (r->sortkey || hotBucket(r, old) || r->bstats[old].npages >= HOTCHAIN) {
+        // sorted buckets and long chains start again from single
+        //   empty pages, and insertion puts each tuple in its place
+        //   (in order, or in its segment)
+        // re-inserting into a long chain would walk it every time
+        Count ntups;
+        char *tups = collectBucket(r, old, &ntups);
+        if (r->scheme == LINEAR_HASH) r->sp++;
+        char *c = tups;
+        for (Count i = 0; i < ntups; i++, c += strlen(c) + 1)
+            insertTuple(r, c);
+        free(tups);
+        if (r->scheme == LINEAR_HASH && r->sp == 1 << r->depth) {
+            r->depth++;
+            r->sp = 0;
+        }
+        return;
+    }
+    // sp keeps its chain of (soon to be empty) pages
+    bs = &r->bstats[old];
+    bs->ntuples = 0; bs->free = bs->npages*emptyPageSpace();
 
     // get and remove all tuples in sp primary page
-    Page currPage = getPage(dataFile(r), r->sp);
+    Page currPage = getPage(dataFile(r), old);
     Page new = newPage();
     pageSetOvflow(new, pageOvflow(currPage));
-    putPage(dataFile(r), r->sp, new);
+    putPage(dataFile(r), old, new);
 
     // start splitting
     // move sp forward to make insertion get 
     // depth+1 lower bits of tuple in old sp
-    r->sp++;
+    // (spiral storage moved on when the new bucket was added)
+    if (r->scheme == LINEAR_HASH) r->sp++;
 
     // scan all tuples in current page
     // and insert it again using depth+1 lower bits
-    Count nTupleScanned = 0;
-    Tuple curtup = pageData(currPage);
-    while (nTupleScanned < pageNTuples(currPage)) {
-        addToRelation(r, curtup);
-        while (*curtup != '\0') curtup++;
-        curtup++;
-        nTupleScanned++;
-    }
+    PageScan scan;
+    Tuple curtup;
+    startPageScan(&scan, currPage, r->nattrs, r->layout);
+    while ((curtup = nextPageTuple(&scan)) != NULL)
+        insertTuple(r, curtup);
 
     // no more tuples in primary page
     // get next overflow pages, remove all tuples
@@ -258,68 +1375,696 @@ static void splitSp(Reln r)
         pageSetOvflow(new, pageOvflow(currPage));
         putPage(ovflowFile(r), currId, new);
 
-        nTupleScanned = 0;
-        curtup = pageData(currPage);
-        while (nTupleScanned < pageNTuples(currPage)) {
-            addToRelation(r, curtup);
-            while (*curtup != '\0') curtup++;
-            curtup++;
-            nTupleScanned++;
-        }
+        startPageScan(&scan, currPage, r->nattrs, r->layout);
+        while ((curtup = nextPageTuple(&scan)) != NULL)
+            insertTuple(r, curtup);
     }
     // all overflow pages scanned (if any) and tuples re-inserted
     // release last scanned page
     free(currPage);
 
     // if sp reaches 2^d-1 offset, increment depth, reset sp to 0
-    if (r->sp == 1 << r->depth) {
+    if (r->scheme == LINEAR_HASH && r->sp == 1 << r->depth) {
         r->depth++;
         r->sp = 0;
     }
 }
 
+static PageID addBucket(Reln r)
+{
+    addPage(dataFile(r));
+    r->npages++;
+    if (r->npages > r->nbstats) {
+        r->nbstats *= 2;
+        r->bstats = realloc(r->bstats, r->nbstats*sizeof(BucketStats));
+        assert(r->bstats != NULL);
+    }
+    BucketStats *bs = &r->bstats[r->npages-1];
+    bs->ntuples = 0; bs->npages = 1; bs->free = emptyPageSpace();
+    if (r->sortkey) resetFences(r, r->npages-1, r->npages-1);
+    return r->npages-1;
+}
+
+// bucket that holds tuples with composite hash h
+
+PageID hashBucket(Reln r, HashBits h)
+{
+    if (r->scheme == SPIRAL_HASH)
+        return spiralPage(spiralAddr(r->npages, hashPos(h)));
+    if (r->scheme == EXTENDIBLE_HASH)
+        return r->dir[h & ((1u << r->depth) - 1)];
+    PageID p = getLower(h, r->depth);
+    if (p < r->sp) p = getLower(h, r->depth+1);
+    return p;
+}
+
+// spiral storage
+// a file of n buckets holds logical buckets n..2n-1; a hash value's
+//   position x in [0,1) is the hash with its bits reversed (so the
+//   first choice vector bits count most), and its logical bucket
+//   is floor(2^(k+x)) for whichever k puts that in n..2n-1
+// each bucket covers one range of positions; lower buckets cover
+//   longer ranges, so the fullest bucket is always the next split
+// logical bucket a = 2^t*o (o odd) is stored in bucket (o-1)/2, so
+//   splitting n reuses n's bucket for 2n and adds bucket n for 2n+1
+
+static HashPos hashPos(HashBits h)
+{
+    HashPos x = 0;
+    for (int i = 0; i < SPIRALBITS; i++)
+        if (bitIsSet(h, i)) x |= (HashPos)1 << (SPIRALBITS-1-i);
+    return x;
+}
+
+// first position covered by logical bucket a
+
+static HashPos spiralLow(Offset a)
+{
+    int k = 0;
+    while ((a >> k) > 1) k++;
+    if (a == 1u << k) return 0;
+    return (HashPos)ldexp(log2(a) - k, SPIRALBITS);
+}
+
+// position just after those covered by logical bucket a
+
+static HashPos spiralHigh(Offset a)
+{
+    Offset next = a + 1;
+    if ((next & a) == 0) return (HashPos)1 << SPIRALBITS;
+    return spiralLow(next);
+}
+
+// logical bucket holding position x, in a file of first buckets
+
+static Offset spiralAddr(Count first, HashPos x)
+{
+    // first..top-1 cover positions from spiralLow(first) on,
+    //   and top..2*first-1 cover the positions before that
+    Offset top = 1;
+    while (top <= first) top <<= 1;
+    Offset lo, hi;
+    if (x >= spiralLow(first)) {
+        lo = first; hi = top;
+    } else {
+        lo = top; hi = 2*first;
+    }
+    // last bucket in lo..hi-1 that starts at or before x
+    while (hi - lo > 1) {
+        Offset mid = lo + (hi - lo)/2;
+        if (spiralLow(mid) <= x) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+static PageID spiralPage(Offset a)
+{
+    while ((a & 1) == 0) a >>= 1;
+    return a/2;
+}
+
+// least position >= from whose bits (in hash order) match val
+//   wherever mask is set
+// returns FALSE if there is none
+
+static Bool nextPos(HashPos from, HashBits mask, HashBits val, HashPos *x)
+{
+    HashPos m = hashPos(mask), v = hashPos(val) & m;
+    if (from >> SPIRALBITS) return FALSE;
+    if ((from & m) == v) {
+        *x = from;
+        return TRUE;
+    }
+    // keep from's bits above some 0 bit that can become 1,
+    //   and make the bits below it as small as possible
+    for (int i = 0; i < SPIRALBITS; i++) {
+        HashPos bit = (HashPos)1 << i;
+        if ((from & bit) || ((m & bit) && !(v & bit))) continue;
+        HashPos above = ~(2*bit - 1);
+        if ((from & m & above) != (v & above)) continue;
+        *x = (from & above) | bit | (v & (bit - 1));
+        return TRUE;
+    }
+    return FALSE;
+}
+
+// next bucket of a spiral or extendible hashing relation that may
+//   hold hashes matching val on the bits in mask
+// *from holds the scan's place (0 to start), and is moved past
+//   the bucket found
+// returns FALSE when no buckets are left
+
+Bool nextHashBucket(Reln r, HashBits mask, HashBits val, HashPos *from, PageID *b)
+{
+    HashPos x;
+    assert(r->scheme != LINEAR_HASH);
+    if (r->scheme == EXTENDIBLE_HASH) return nextDirBucket(r, mask, val, from, b);
+    // spiral buckets are visited in position order
+    if (!nextPos(*from, mask, val, &x)) return FALSE;
+    Offset a = spiralAddr(r->npages, x);
+    *b = spiralPage(a);
+    *from = spiralHigh(a);
+    return TRUE;
+}
+
+// copy of tuple t with its longest values moved to rel.lob, until
+//   it fits in a page
+// the sort attribute always stays, as buckets are ordered on it
+// returns NULL if t can't be made to fit
+
+static Tuple spillValues(Reln r, Tuple t)
+{
+    Count n = r->nattrs, max = pageMaxTuple(n, r->layout);
+    char **vals = malloc(n*sizeof(char *));
+    assert(vals != NULL);
+    tupleVals(t, vals);
+    Count len = tupLength(t);
+    while (len > max) {
+        int big = -1;
+        Count blen = LOBREFLEN;
+        for (Count a = 0; a < n; a++) {
+            Count vlen = strlen(vals[a]);
+            if (vlen > blen && a+1 != r->sortkey) {
+                big = a; blen = vlen;
+            }
+        }
+        if (big < 0) break;
+        if (r->lob == NULL) {
+            char fname[MAXFILENAME];
+            sprintf(fname,"%s.lob",r->name);
+            r->lob = fopen(fname,"w+");
+            assert(r->lob != NULL);
+        }
+        char ref[LOBREFLEN+1];
+        lobPut(r->lob, vals[big], blen,
+               hash_any((unsigned char *)vals[big], blen), ref);
+        free(vals[big]);
+        vals[big] = copyString(ref);
+        len -= blen - LOBREFLEN;
+    }
+    Tuple s = NULL;
+    if (len <= max) {
+        s = malloc(len+1);
+        assert(s != NULL);
+        char *c = s;
+        for (Count a = 0; a < n; a++) {
+            if (a > 0) *c++ = ',';
+            strcpy(c, vals[a]);
+            c += strlen(vals[a]);
+        }
+    }
+    freeVals(vals, n);
+    free(vals);
+    return s;
+}
+
+// Hot buckets
+// - when many tuples share the values that place them in a bucket,
+//   splitting doesn't shorten its chain, and each insertion would
+//   walk the whole chain
+// - so a chain of HOTCHAIN pages is rebuilt as NHOTSEG segments, on
+//   the top HOTSEGBITS bits of the composite hash (which placing
+//   buckets doesn't use), each with its pages together in the chain
+// - an insertion goes straight to the last page of its segment, and
+//   a query that knows the segment bits reads only that segment
+//   (plus the primary page)
+// - the chain is still an ordinary chain to everything else
+// - rel.hot holds #hot buckets, then each one's PageID and HotDir
+
+static void loadHot(Reln r)
+{
+    char fname[MAXFILENAME];
+    sprintf(fname,"%s.hot",r->name);
+    FILE *f = fopen(fname,"r");
+    if (f == NULL) return;
+    Count n;
+    if (fread(&n, sizeof(Count), 1, f) != 1) n = 0;
+    for (Count i = 0; i < n; i++) {
+        PageID b;
+        HotDir *d = malloc(sizeof(HotDir));
+        assert(d != NULL);
+        if (fread(&b, sizeof(PageID), 1, f) != 1
+            || fread(d, sizeof(HotDir), 1, f) != 1 || b >= r->npages) {
+            free(d);
+            break;
+        }
+        dropHot(r, b);
+        r->hot[b] = d;
+    }
+    fclose(f);
+}
+
+static void saveHot(Reln r)
+{
+    char fname[MAXFILENAME];
+    sprintf(fname,"%s.hot",r->name);
+    Count n = 0;
+    for (PageID b = 0; b < r->maxhot; b++)
+        if (r->hot[b] != NULL) n++;
+    if (n == 0) {
+        remove(fname);
+        return;
+    }
+    FILE *f = fopen(fname,"w");
+    assert(f != NULL);
+    int ok = fwrite(&n, sizeof(Count), 1, f);
+    for (PageID b = 0; b < r->maxhot; b++) {
+        if (r->hot[b] == NULL) continue;
+        ok += fwrite(&b, sizeof(PageID), 1, f);
+        ok += fwrite(r->hot[b], sizeof(HotDir), 1, f);
+    }
+    assert(ok == 1 + 2*n);
+    fclose(f);
+}
+
+// bucket b goes back to being an ordinary chain
+// (also makes room for b in r->hot)
+
+static void dropHot(Reln r, PageID b)
+{
+    if (b >= r->maxhot) {
+        Count n = r->maxhot == 0 ? r->npages : r->maxhot;
+        while (n <= b) n *= 2;
+        r->hot = realloc(r->hot, n*sizeof(HotDir *));
+        assert(r->hot != NULL);
+        memset(&r->hot[r->maxhot], 0, (n-r->maxhot)*sizeof(HotDir *));
+        r->maxhot = n;
+    }
+    free(r->hot[b]);
+    r->hot[b] = NULL;
+}
+
+// rebuild bucket b's chain as segments
+
+static void makeHot(Reln r, PageID b)
+{
+    Count ntups;
+    char *tups = collectBucket(r, b, &ntups);
+    HotDir *d = malloc(sizeof(HotDir));
+    assert(d != NULL);
+    for (Count j = 0; j < NHOTSEG; j++) {
+        d->first[j] = d->last[j] = NO_PAGE;
+        d->npages[j] = 0;
+    }
+    d->npages[0] = 1;
+    r->hot[b] = d;
+    Bits hashVals[MAXATTRS];
+    char *c = tups;
+    for (Count i = 0; i < ntups; i++, c += strlen(c) + 1) {
+        Status ok = addHot(r, b, c, tupleAttrHash(r, c, hashVals));
+        assert(ok == OK);
+    }
+    free(tups);
+}
+
+// add tuple t, with composite hash h, to its segment of bucket b
+// a new page is linked in after the segment's last page, or after
+//   the last page of the segment before it, if it has none
+
+static Status addHot(Reln r, PageID b, Tuple t, HashBits h)
+{
+    HotDir *d = r->hot[b];
+    Count j = hotSegment(h), i = j;
+    while (d->npages[i] == 0) i--;
+    PageID pid = d->last[i];
+    FILE *f = pid == NO_PAGE ? r->data : r->ovflow;
+    Page pg = getPage(f, pid == NO_PAGE ? b : pid);
+    if (i == j && addTuple(r, b, pg, t) == OK) {
+        putPage(f, pid == NO_PAGE ? b : pid, pg);
+        return OK;
+    }
+    PageID newp = newOvflowPage(r, b);
+    noteNewPage(r, b);
+    Page newpg = getPage(r->ovflow, newp);
+    if (addTuple(r, b, newpg, t) != OK) {
+        free(pg);
+        free(newpg);
+        return ~OK;
+    }
+    pageSetOvflow(newpg, pageOvflow(pg));
+    pageSetOvflow(pg, newp);
+    putPage(r->ovflow, newp, newpg);
+    putPage(f, pid == NO_PAGE ? b : pid, pg);
+    if (d->npages[j] == 0) d->first[j] = newp;
+    d->last[j] = newp;
+    d->npages[j]++;
+    return OK;
+}
+
+Bool hotBucket(Reln r, PageID b)
+{
+    return b < r->maxhot && r->hot[b] != NULL;
+}
+
+// first page of segment j of hot bucket b (NULL if it's empty),
+//   with *npages set to the number of pages in the segment
+// the rest of them come from nextBucketPage()
+
+Page hotSegmentPage(Reln r, PageID b, Count j, Count *npages)
+{
+    HotDir *d = r->hot[b];
+    assert(d != NULL && j < NHOTSEG);
+    *npages = d->npages[j];
+    if (*npages == 0) return NULL;
+    if (j == 0) return getPage(r->data, b);
+    return getPage(r->ovflow, d->first[j]);
+}
+
+// Extendible hashing
+// - a directory maps the low depth bits of the hash to a bucket,
+//   and a bucket with local depth ld is the target of all entries
+//   that agree on its low ld bits
+// - when a bucket fills up, it alone is split on its next hash bit,
+//   doubling the directory if that bit isn't in it yet
+// - rel.dir holds #buckets, their DirBucket entries, then the
+//   2^depth directory entries
+
+static void loadDirectory(Reln r)
+{
+    char fname[MAXFILENAME];
+    sprintf(fname,"%s.dir",r->name);
+    FILE *f = fopen(fname,"r");
+    assert(f != NULL);
+    Count n, nent = 1u << r->depth;
+    if (fread(&n, sizeof(Count), 1, f) != 1) n = 0;
+    assert(n == r->npages);
+    r->maxdirb = n;
+    r->dirb = malloc(n*sizeof(DirBucket));
+    r->dir = malloc(nent*sizeof(PageID));
+    assert(r->dirb != NULL && r->dir != NULL);
+    n = fread(r->dirb, sizeof(DirBucket), r->npages, f);
+    assert(n == r->npages);
+    n = fread(r->dir, sizeof(PageID), nent, f);
+    assert(n == nent);
+    fclose(f);
+}
+
+static void saveDirectory(Reln r)
+{
+    char fname[MAXFILENAME];
+    sprintf(fname,"%s.dir",r->name);
+    FILE *f = fopen(fname,"w");
+    assert(f != NULL);
+    Count nent = 1u << r->depth;
+    int n = fwrite(&r->npages, sizeof(Count), 1, f);
+    n += fwrite(r->dirb, sizeof(DirBucket), r->npages, f);
+    n += fwrite(r->dir, sizeof(PageID), nent, f);
+    assert(n == 1 + r->npages + nent);
+    fclose(f);
+}
+
+// split bucket b, which holds hash h, on the lowest bit where its
+//   tuples' hashes (and h) differ
+// if they don't differ below MAXDIRDEPTH, splitting would not help,
+//   so b is left to overflow until it has grown by half again
+// returns FALSE if b was not split
+
+static Bool splitBucket(Reln r, PageID b, HashBits h)
+{
+    Count ntups;
+    Count ld = r->dirb[b].ldepth;
+    if (ld >= MAXDIRDEPTH) return FALSE;
+    char *tups = collectBucket(r, b, &ntups);
+    HashBits diff = 0;
+    Bits hashVals[MAXATTRS];
+    char *c = tups;
+    for (Count i = 0; i < ntups; i++, c += strlen(c) + 1)
+        diff |= tupleAttrHash(r, c, hashVals) ^ h;
+    diff &= ~((1u << ld) - 1) & ((1u << MAXDIRDEPTH) - 1);
+    r->splitting = TRUE;
+    if (diff == 0) {
+        // put them back
+        r->dirb[b].nosplit = ntups + ntups/2 + 1;
+        for (c = tups; ntups > 0; ntups--, c += strlen(c) + 1)
+            insertTuple(r, c);
+        r->splitting = FALSE;
+        free(tups);
+        return FALSE;
+    }
+    // split on each bit up to the first one that separates
+    //   the tuples, following them (and h) along the way
+    for (;;) {
+        ld = r->dirb[b].ldepth;
+        if (ld == r->depth) {
+            Count nent = 1u << r->depth;
+            r->dir = realloc(r->dir, 2*nent*sizeof(PageID));
+            assert(r->dir != NULL);
+            memcpy(&r->dir[nent], r->dir, nent*sizeof(PageID));
+            r->depth++;
+        }
+        PageID nb = addBucket(r);
+        if (nb >= r->maxdirb) {
+            r->maxdirb *= 2;
+            r->dirb = realloc(r->dirb, r->maxdirb*sizeof(DirBucket));
+            assert(r->dirb != NULL);
+        }
+        r->dirb[b].ldepth = r->dirb[nb].ldepth = ld + 1;
+        r->dirb[b].nosplit = r->dirb[nb].nosplit = 0;
+        // entries for b with bit ld set now go to nb
+        Bits low = h & ((1u << ld) - 1);
+        for (Bits k = 0; k < 1u << (r->depth - ld); k++) {
+            Bits e = low | (k << ld);
+            if (bitIsSet(e, ld)) r->dir[e] = nb;
+        }
+        if (bitIsSet(diff, ld)) break;
+        if (bitIsSet(h, ld)) b = nb;
+    }
+    for (c = tups; ntups > 0; ntups--, c += strlen(c) + 1)
+        insertTuple(r, c);
+    r->splitting = FALSE;
+    free(tups);
+    return TRUE;
+}
+
+// directory entries matching val on the bits in mask (in the low
+//   depth bits) are visited in turn, and each bucket is returned
+//   for the first matching entry that refers to it
+// *from holds the unknown bits of the next entry, with bit 32 set
+//   at the end
+
+static Bool nextDirBucket(Reln r, HashBits mask, HashBits val, HashPos *from, PageID *b)
+{
+    Bits all = (1u << r->depth) - 1;
+    Bits unk = ~mask & all;
+    val &= mask & all;
+    while (*from <= unk) {
+        Bits e = val | (Bits)*from;
+        // next combination of the unknown bits
+        *from = *from == unk ? (HashPos)unk + 1
+                             : ((*from | ~(HashPos)unk) + 1) & unk;
+        PageID p = r->dir[e];
+        Bits above = all & ~((1u << r->dirb[p].ldepth) - 1);
+        if ((e & above) != (val & above)) continue;
+        *b = p;
+        return TRUE;
+    }
+    return FALSE;
+}
 
 // external interfaces for Reln data
 
 FILE *dataFile(Reln r) { return r->data; }
 FILE *ovflowFile(Reln r) { return r->ovflow; }
+FILE *lobFile(Reln r) { return r->lob; }
 Count nattrs(Reln r) { return r->nattrs; }
 Count npages(Reln r) { return r->npages; }
 Count ntuples(Reln r) { return r->ntups; }
 Count depth(Reln r)  { return r->depth; }
 Count splitp(Reln r) { return r->sp; }
+Count layout(Reln r) { return r->layout; }
+Count hashScheme(Reln r) { return r->scheme; }
+Bool frozen(Reln r) { return r->frozen; }
+char *relName(Reln r) { return r->name; }
 ChVecItem *chvec(Reln r)  { return r->cv; }
 
+// pages of a bucket, in chain order
+// firstBucketPage() fetches the primary page of bucket b;
+// nextBucketPage() releases page p and fetches the page after it,
+//   returning NULL at the end of the chain
+
+// in a frozen relation, the whole extent is read along with the
+//   primary page, and the rest of the chain comes from that
+
+Page firstBucketPage(Reln r, PageID b)
+{
+    assert(b < r->npages);
+    if (!r->frozen) return getPage(r->data, b);
+    free(r->ebuf);
+    r->ebucket = b;
+    r->ebuf = getPages(r->data, r->extent[b], r->extent[b+1]-r->extent[b]);
+    return copyPage(r->ebuf, 0);
+}
+
+Page nextBucketPage(Reln r, Page p)
+{
+    PageID ovp = pageOvflow(p);
+    free(p);
+    if (ovp == NO_PAGE) return NULL;
+    if (!r->frozen) return getPage(r->ovflow, ovp);
+    Offset first = r->extent[r->ebucket];
+    if (r->ebuf != NULL && ovp >= first && ovp < r->extent[r->ebucket+1])
+        return copyPage(r->ebuf, ovp - first);
+    return getPage(r->data, ovp);
+}
+
+// estimated #distinct values of attribute a, from its sketch
+
+double distinctVals(Reln r, Count a)
+{
+    assert(a < r->nattrs);
+    return hllEstimate(r->hll + a*HLLREGS);
+}
+
+
+// per-bucket counters, indexed by bucket number
+// loaded from rel.bstats on first use, or rebuilt from
+//   the pages if that file is missing or out of date
+// (it is out of date if the relation's #buckets or #tuples
+//   changed without it being rewritten)
+
+BucketStats *bucketStats(Reln r)
+{
+    if (r->bstats != NULL) return r->bstats;
+    r->nbstats = r->npages;
+    r->bstats = malloc(r->nbstats*sizeof(BucketStats));
+    assert(r->bstats != NULL);
+    char fname[MAXFILENAME];
+    sprintf(fname,"%s.bstats",r->name);
+    FILE *f = fopen(fname,"r");
+    Bool ok = FALSE;
+    if (f != NULL) {
+        Count head[3];
+        ok = fread(head, sizeof(Count), 3, f) == 3 && head[0] == BSTATS_MAGIC
+             && head[1] == r->npages && head[2] == r->ntups
+             && fread(r->bstats, sizeof(BucketStats), r->npages, f) == r->npages;
+        fclose(f);
+    }
+    if (!ok) scanBucketStats(r, r->bstats, FALSE);
+    return r->bstats;
+}
+
+// walk every page of every bucket, filling in bs[]
+// if show, also print (pageID,#tuples,freebytes,ovflow) for each page
+
+static void scanBucketStats(Reln r, BucketStats *bs, Bool show)
+{
+    if (show) {
+        printf("%-4s %s\n","#","Info on pages in bucket");
+        printf("%-4s %s\n","","(pageID,#tuples,freebytes,ovflow)");
+    }
+    // chains of frozen relations stay in the data file
+    char *ov = r->frozen ? "d" : "ov";
+    for (Offset pid = 0; pid < r->npages; pid++) {
+        Offset curid = r->frozen ? r->extent[pid] : pid;
+        bs[pid].ntuples = 0;
+        bs[pid].npages = 0;
+        bs[pid].free = 0;
+        if (show) printf("[%2d]  ",pid);
+        for (Page p = firstBucketPage(r, pid); p != NULL;
+             p = nextBucketPage(r, p)) {
+            Count ntups = pageNTuples(p);
+            Count space = pageFreeSpace(p);
+            Offset ovid = pageOvflow(p);
+            if (show) printf("%s(%s%d,%d,%d,%d)", bs[pid].npages ? " -> " : "",
+                             bs[pid].npages ? ov : "d", curid, ntups, space, ovid);
+            bs[pid].ntuples += ntups;
+            bs[pid].npages++;
+            bs[pid].free += space;
+            curid = ovid;
+        }
+        if (show) putchar('\n');
+    }
+}
 
 // displays info about open Reln
+// bucket info comes from the incrementally maintained counters,
+//   so no data pages are read
+
+#define NCHAINHIST 10   // chain length histogram has 0..9 and 10+
 
 void relationStats(Reln r)
 {
     printf("Global Info:\n");
-    printf("#attrs:%d  #pages:%d  #tuples:%d  d:%d  sp:%d\n",
-           r->nattrs, r->npages, r->ntups, r->depth, r->sp);
+    if (r->scheme == SPIRAL_HASH)
+        printf("#attrs:%d  #pages:%d  #tuples:%d  spiral  layout:%s%s\n",
+               r->nattrs, r->npages, r->ntups,
+               r->layout == PAX_LAYOUT ? "pax" : "row",
+               r->frozen ? "  frozen" : "");
+    else if (r->scheme == EXTENDIBLE_HASH)
+        printf("#attrs:%d  #pages:%d  #tuples:%d  extendible d:%d  layout:%s%s\n",
+               r->nattrs, r->npages, r->ntups, r->depth,
+               r->layout == PAX_LAYOUT ? "pax" : "row",
+               r->frozen ? "  frozen" : "");
+    else
+        printf("#attrs:%d  #pages:%d  #tuples:%d  d:%d  sp:%d  layout:%s%s\n",
+               r->nattrs, r->npages, r->ntups, r->depth, r->sp,
+               r->layout == PAX_LAYOUT ? "pax" : "row",
+               r->frozen ? "  frozen" : "");
+    if (r->sortkey)
+        printf("buckets sorted on attribute %d\n", r->sortkey-1);
+    if (r->lob != NULL) {
+        fseek(r->lob, 0, SEEK_END);
+        printf("large values: %ld bytes in %s.lob\n", ftell(r->lob), r->name);
+    }
+    printf("Estimated distinct values per attribute\n");
+    for (Count a = 0; a < r->nattrs; a++)
+        printf("%s%d:%.0f", a == 0 ? "" : "  ", a, distinctVals(r, a));
+    putchar('\n');
     printf("Choice vector\n");
     printChVec(r->cv);
+
+    BucketStats *bs = bucketStats(r);
+    Count space = emptyPageSpace();
+    Count chainHist[NCHAINHIST+1] = {0}, fillHist[10] = {0};
+    Count maxChain = 0, totPages = 0;
     printf("Bucket Info:\n");
-    printf("%-4s %s\n","#","Info on pages in bucket");
-    printf("%-4s %s\n","","(pageID,#tuples,freebytes,ovflow)");
-    for (Offset pid = 0; pid < r->npages; pid++) {
-        printf("[%2d]  ",pid);
-        Page p = getPage(r->data, pid);
-        Count ntups = pageNTuples(p);
-        Count space = pageFreeSpace(p);
-        Offset ovid = pageOvflow(p);
-        printf("(d%d,%d,%d,%d)",pid,ntups,space,ovid);
-        free(p);
-        while (ovid != NO_PAGE) {
-            Offset curid = ovid;
-            p = getPage(r->ovflow, ovid);
-            ntups = pageNTuples(p);
-            space = pageFreeSpace(p);
-            ovid = pageOvflow(p);
-            printf(" -> (ov%d,%d,%d,%d)",curid,ntups,space,ovid);
-            free(p);
-        }
-        putchar('\n');
+    printf("%-4s %s\n","#","(#tuples,#pages,freebytes,fill%)");
+    for (Offset b = 0; b < r->npages; b++) {
+        Count cap = bs[b].npages*space;
+        double fill = (double)(cap - bs[b].free)/cap;
+        printf("[%2d]  (%d,%d,%d,%.0f%%)\n", b, bs[b].ntuples,
+               bs[b].npages, bs[b].free, 100*fill);
+        Count chain = bs[b].npages - 1;
+        chainHist[chain < NCHAINHIST ? chain : NCHAINHIST]++;
+        if (chain > maxChain) maxChain = chain;
+        fillHist[fill >= 1.0 ? 9 : (int)(fill*10)]++;
+        totPages += bs[b].npages;
+    }
+    printf("Overflow chain length histogram (max %d, mean %.2f)\n",
+           maxChain, (double)(totPages - r->npages)/r->npages);
+    for (int i = 0; i <= NCHAINHIST; i++) {
+        if (chainHist[i] == 0) continue;
+        printf("  %2d%s: %d\n", i, i == NCHAINHIST ? "+" : " ", chainHist[i]);
+    }
+    printf("Bucket fill factor histogram\n");
+    for (int i = 0; i < 10; i++) {
+        if (fillHist[i] == 0) continue;
+        printf("  %3d-%3d%%: %d\n", 10*i, 10*i+10, fillHist[i]);
+    }
+}
+
+// read every page to check the bucket counters
+// shows each page on the way, and any disagreements at the end
+// returns the number of buckets whose counters are wrong
+
+Count verifyRelationStats(Reln r)
+{
+    BucketStats *kept = bucketStats(r);
+    BucketStats *bs = malloc(r->npages*sizeof(BucketStats));
+    assert(bs != NULL);
+    scanBucketStats(r, bs, TRUE);
+    Count nbad = 0, ntups = 0;
+    for (Offset b = 0; b < r->npages; b++) {
+        ntups += bs[b].ntuples;
+        if (memcmp(&bs[b], &kept[b], sizeof(BucketStats)) == 0) continue;
+        printf("bucket %d: counters (%d,%d,%d) but pages have (%d,%d,%d)\n",
+               b, kept[b].ntuples, kept[b].npages, kept[b].free,
+               bs[b].ntuples, bs[b].npages, bs[b].free);
+        nbad++;
     }
+    if (ntups != r->ntups)
+        printf("#tuples is %d but pages hold %d\n", r->ntups, ntups);
+    printf("%d bucket(s) with wrong counters\n", nbad);
+    free(bs);
+    return nbad + (ntups != r->ntups);
 }
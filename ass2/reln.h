@@ -12,19 +12,70 @@ typedef struct RelnRep *Reln;
 #include "tuple.h"
 #include "page.h"
 #include "chvec.h"
+#include "bits.h"
 
-Status newRelation(char *name, Count nattr, Count npages, Count d, char *cv);
+// counters kept for each bucket (primary page + overflow chain)
+typedef struct BucketStats {
+	Count ntuples;  // tuples in bucket
+	Count npages;   // pages in bucket, including primary page
+	Count free;     // free bytes over all pages in bucket
+} BucketStats;
+
+// how the file grows (newRelation's scheme)
+#define LINEAR_HASH 0   // split buckets in turn at the split pointer
+#define SPIRAL_HASH 1   // spiral storage: split the fullest bucket
+#define EXTENDIBLE_HASH 2  // split whichever bucket fills up
+
+// hot buckets' chains are split into NHOTSEG segments on the top
+//   HOTSEGBITS bits of the composite hash
+#define HOTSEGBITS 4
+#define NHOTSEG (1 << HOTSEGBITS)
+#define hotSegment(h) ((h) >> (MAXBITS - HOTSEGBITS))
+
+// spiral storage places buckets by the low SPIRALBITS bits of
+//   the composite hash
+#define SPIRALBITS 32
+
+// place in a scan of a spiral or extendible hashing relation's
+//   buckets (for spiral storage, a hash value's position, scaled
+//   by 2^SPIRALBITS)
+typedef unsigned long long HashPos;
+
+Status newRelation(char *name, Count nattr, Count npages, Count d, char *cv,
+                   Count layout, int sortatt, Count scheme);
 Reln openRelation(char *name, char *mode);
 void closeRelation(Reln r);
 Bool existsRelation(char *name);
+void removeRelation(char *name);
+Status freezeRelation(char *name);
+Status upgradeRelation(char *name);
 PageID addToRelation(Reln r, Tuple t);
+PageID hashBucket(Reln r, HashBits h);
+Bool nextHashBucket(Reln r, HashBits mask, HashBits val, HashPos *from, PageID *b);
+Status vacuumBucket(Reln r, PageID b);
+Count freeOvflowPages(Reln r);
 FILE *dataFile(Reln r);
 FILE *ovflowFile(Reln r);
+FILE *lobFile(Reln r);
 Count nattrs(Reln r);
 Count npages(Reln r);
+Count ntuples(Reln r);
 Count depth(Reln r);
 Count splitp(Reln r);
+Count layout(Reln r);
+Count hashScheme(Reln r);
+Bool frozen(Reln r);
+char *relName(Reln r);
+int sortAttr(Reln r);
 ChVecItem *chvec(Reln r);
+double distinctVals(Reln r, Count a);
+BucketStats *bucketStats(Reln r);
+Page firstBucketPage(Reln r, PageID b);
+Page nextBucketPage(Reln r, Page p);
+Page seekBucketPage(Reln r, PageID b, char *key, Count *npages);
+Bool hotBucket(Reln r, PageID b);
+Page hotSegmentPage(Reln r, PageID b, Count j, Count *npages);
 void relationStats(Reln r);
+Count verifyRelationStats(Reln r);
 
 #endif
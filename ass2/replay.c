@@ -0,0 +1,358 @@
+// replay.c ... replay a recorded workload against a relation
+// part of Multi-attribute linear-hashed files
+// Reads a trace (recorded by running tools with LHTRACE=File) and
+//   does its inserts and selects on RelName, at the times they were
+//   recorded at (relative to the first), or faster, from several
+//   clients at once, then shows the latency of each kind of
+//   operation, beside its latency when recorded
+// Usage:  ./replay  [-x speed]  [-c clients]  [-f RelName]  [-o File]
+//                   RelName  <  trace
+// where -x speed = how many times faster than recorded (default 1;
+//                  0 = as fast as possible)
+//       -c clients = clients doing the operations (default 1);
+//                  operations are dealt out to them in turn
+//       -f RelName = only replay operations recorded on RelName
+//                  (default all of them)
+//       -o File = also write the results as JSON
+// Only one client uses the relation at a time, so a latency
+//   includes waiting for other clients; the lag is how far behind
+//   its recorded time (scaled by speed) an operation started
+// A select's latency is until its last match is fetched; selects
+//   that found a different number of matches than when recorded
+//   are counted
+
+#define _POSIX_C_SOURCE 200112L
+#include <time.h>
+#include <pthread.h>
+#include "defs.h"
+#include "reln.h"
+#include "query.h"
+#include "part.h"
+#include "trace.h"
+
+#define USAGE "./replay  [-x speed]  [-c clients]  [-f RelName]  [-o File]  RelName  <  trace"
+#define MAXCLIENTS 64
+#define BATCHSIZE 256   // tuple refs fetched per scan call
+
+// kinds of operation reported
+#define INSERT_OP 0
+#define POINT_OP 1    // select with every attribute known
+#define PARTIAL_OP 2  // select with some attributes known
+#define FULL_OP 3     // select with no attributes known
+#define NOPKINDS 4
+
+static char *opKind[NOPKINDS] = { "insert", "point", "partial", "full" };
+
+// an operation from the trace, and how its replay went
+typedef struct Op {
+	int kind;        // one of the above
+	double at;       // seconds after the first operation
+	double recsecs;  // latency when recorded
+	long recfound;   // #matches when recorded (selects)
+	char *arg;       // tuple or query string
+	double secs;     // latency when replayed
+	double lag;      // how late it started
+	long found;      // #matches when replayed
+} Op;
+
+// what the clients share
+typedef struct Replay {
+	Op *ops;
+	long nops;
+	int nclients;
+	double speed;
+	double start;        // when the replay began
+	Reln r;              // the relation, or
+	Parts parts;         //   its partitions
+	FILE *sink;          // where partitioned selects' matches go
+	pthread_mutex_t lock;  // one client at a time uses the relation
+} Replay;
+
+// one client, doing every nclients'th operation
+typedef struct Client {
+	Replay *rp;
+	int id;
+} Client;
+
+// wait until time t (as given by now())
+
+static void waitUntil(double t)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t)t;
+	ts.tv_nsec = (long)((t - ts.tv_sec)*1e9);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+		;
+}
+
+static int cmpOp(const void *a, const void *b)
+{
+	double x = ((Op *)a)->at, y = ((Op *)b)->at;
+	return (x > y) - (x < y);
+}
+
+// what kind of select query string q is
+
+static int selectKind(char *q)
+{
+	int nvals = 1, nunknown = 0;
+	for (char *c = q; *c != '\0'; c++) {
+		if (*c == ',') nvals++;
+		if (*c == '?' && (c == q || c[-1] == ',') && (c[1] == ',' || c[1] == '\0'))
+			nunknown++;
+	}
+	return (nunknown == 0) ? POINT_OP : (nunknown == nvals) ? FULL_OP : PARTIAL_OP;
+}
+
+// #attributes in tuple or query string t
+
+static Count countVals(char *t)
+{
+	Count n = 1;
+	for (char *c = t; *c != '\0'; c++) {
+		if (*c == ',') n++;
+	}
+	return n;
+}
+
+// do one operation on the relation
+
+static void doOp(Replay *rp, Op *op)
+{
+	if (op->kind == INSERT_OP) {
+		Count part;
+		PageID pid = (rp->parts != NULL) ? addToParts(rp->parts, op->arg, &part)
+		                                 : addToRelation(rp->r, op->arg);
+		if (pid == NO_PAGE) fatal("Insert failed");
+	}
+	else if (rp->parts != NULL)
+		op->found = scanParts(rp->parts, op->arg, NULL, 0, FALSE, 1, rp->sink);
+	else {
+		TupleRef refs[BATCHSIZE];
+		Query q = startQuery(rp->r, op->arg);
+		int got;
+		op->found = 0;
+		while ((got = getNextTuples(q, refs, BATCHSIZE)) > 0)
+			op->found += got;
+		closeQuery(q);
+	}
+}
+
+// a client's operations, each at its time
+
+static void *runClient(void *arg)
+{
+	Client *c = arg;
+	Replay *rp = c->rp;
+	for (long i = c->id; i < rp->nops; i += rp->nclients) {
+		Op *op = &rp->ops[i];
+		double due = rp->start + (rp->speed > 0 ? op->at/rp->speed : 0);
+		if (rp->speed > 0) waitUntil(due);
+		double t0 = now();
+		op->lag = (rp->speed > 0) ? t0 - due : 0;
+		pthread_mutex_lock(&rp->lock);
+		doOp(rp, op);
+		pthread_mutex_unlock(&rp->lock);
+		op->secs = now() - t0;
+	}
+	return NULL;
+}
+
+// percentile p of the n sorted values in v, in microseconds
+
+static double pct(double *v, long n, double p)
+{
+	return 1e6*percentile(v, n, p);
+}
+
+// Main ... process args, read trace, replay it, show latencies
+
+int main(int argc, char **argv)
+{
+	char err[2*MAXERRMSG];  // buffer for error messages
+	double speed = 1;       // times faster than recorded
+	int nclients = 1;
+	char *only = NULL;      // relation whose operations are replayed
+	FILE *json = NULL;      // where JSON results go
+
+	// process command-line args
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-x") == 0 && arg+1 < argc)
+			speed = atof(argv[++arg]);
+		else if (strcmp(argv[arg], "-c") == 0 && arg+1 < argc)
+			nclients = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-f") == 0 && arg+1 < argc)
+			only = argv[++arg];
+		else if (strcmp(argv[arg], "-o") == 0 && arg+1 < argc) {
+			if ((json = fopen(argv[++arg], "w")) == NULL)
+				fatal("Can't open output file");
+		}
+		else
+			fatal(USAGE);
+		arg++;
+	}
+	if (argc - arg < 1 || speed < 0 || nclients < 1 || nclients > MAXCLIENTS)
+		fatal(USAGE);
+	char *rname = argv[arg];
+
+	// the replay itself is never recorded
+	traceSuspend();
+
+	// read the trace, in order of start time
+
+	Replay rp;
+	long maxops = 1024;
+	rp.ops = malloc(maxops*sizeof(Op));
+	assert(rp.ops != NULL);
+	rp.nops = 0;
+	TraceOp t;
+	char *buf = NULL;
+	int size = 0;
+	Bool inserts = FALSE;
+	while (readTraceOp(stdin, &t, &buf, &size)) {
+		if (only != NULL && strcmp(t.rel, only) != 0) continue;
+		if (rp.nops == maxops) {
+			maxops *= 2;
+			rp.ops = realloc(rp.ops, maxops*sizeof(Op));
+			assert(rp.ops != NULL);
+		}
+		Op *op = &rp.ops[rp.nops++];
+		op->kind = (t.kind == TRACE_INSERT) ? INSERT_OP : selectKind(t.arg);
+		op->at = t.at;
+		op->recsecs = t.secs;
+		op->recfound = t.nfound;
+		op->arg = copyString(t.arg);
+		op->secs = op->lag = 0;
+		op->found = 0;
+		if (op->kind == INSERT_OP) inserts = TRUE;
+	}
+	free(buf);
+	if (rp.nops == 0) fatal("No operations to replay");
+	// (traces from several processes may be a little out of order)
+	qsort(rp.ops, rp.nops, sizeof(Op), cmpOp);
+	double first = rp.ops[0].at;
+	for (long i = 0; i < rp.nops; i++) rp.ops[i].at -= first;
+
+	// open the relation, and check the operations fit it
+
+	char *mode = inserts ? "r+" : "r";
+	rp.r = NULL;
+	rp.parts = NULL;
+	Count nattr;
+	if (isPartitioned(rname)) {
+		if ((rp.parts = openParts(rname, mode)) == NULL) {
+			sprintf(err, "Can't open partitioned relation: %s",rname);
+			fatal(err);
+		}
+		nattr = nattrs(partReln(rp.parts, 0));
+	}
+	else {
+		if (!existsRelation(rname)) {
+			sprintf(err, "No such relation: %s",rname);
+			fatal(err);
+		}
+		if ((rp.r = openRelation(rname, mode)) == NULL) {
+			sprintf(err, "Can't open relation: %s",rname);
+			fatal(err);
+		}
+		nattr = nattrs(rp.r);
+	}
+	for (long i = 0; i < rp.nops; i++) {
+		if (countVals(rp.ops[i].arg) != nattr) {
+			sprintf(err, "Operation doesn't fit %s: %.*s", rname,
+			        MAXERRMSG/2, rp.ops[i].arg);
+			fatal(err);
+		}
+	}
+	rp.sink = fopen("/dev/null", "w");
+	assert(rp.sink != NULL);
+
+	// replay, with each client in a thread of its own
+
+	rp.nclients = (nclients > rp.nops) ? rp.nops : nclients;
+	rp.speed = speed;
+	pthread_mutex_init(&rp.lock, NULL);
+	Client clients[MAXCLIENTS];
+	pthread_t tids[MAXCLIENTS];
+	rp.start = now();
+	for (int c = 0; c < rp.nclients; c++) {
+		clients[c].rp = &rp;
+		clients[c].id = c;
+		pthread_create(&tids[c], NULL, runClient, &clients[c]);
+	}
+	for (int c = 0; c < rp.nclients; c++)
+		pthread_join(tids[c], NULL);
+	double secs = now() - rp.start;
+	pthread_mutex_destroy(&rp.lock);
+
+	// show each kind of operation's latencies, replayed and recorded
+
+	double *lat = malloc(rp.nops*sizeof(double));
+	double *rec = malloc(rp.nops*sizeof(double));
+	assert(lat != NULL && rec != NULL);
+	long mismatches = 0;
+	for (long i = 0; i < rp.nops; i++) {
+		if (rp.ops[i].kind != INSERT_OP && rp.ops[i].found != rp.ops[i].recfound)
+			mismatches++;
+	}
+	printf("%ld operations, %d client(s), speed %gx, %.3f secs, %.0f ops/sec\n",
+	       rp.nops, rp.nclients, speed, secs, rp.nops/secs);
+	printf("%-8s %8s %10s %10s %10s %10s %12s %12s\n", "op", "n", "p50 us",
+	       "p90 us", "p99 us", "max us", "rec p50 us", "rec p99 us");
+	if (json != NULL)
+		fprintf(json, "{\n  \"relation\": \"%s\", \"operations\": %ld, "
+		        "\"clients\": %d, \"speed\": %g,\n  \"secs\": %.6f, "
+		        "\"ops_per_sec\": %.1f, \"mismatches\": %ld,\n",
+		        rname, rp.nops, rp.nclients, speed, secs, rp.nops/secs, mismatches);
+	for (int k = 0; k < NOPKINDS; k++) {
+		long n = 0;
+		for (long i = 0; i < rp.nops; i++) {
+			if (rp.ops[i].kind != k) continue;
+			lat[n] = rp.ops[i].secs;
+			rec[n] = rp.ops[i].recsecs;
+			n++;
+		}
+		if (json != NULL) {
+			fprintf(json, "  \"%s\": {\"latency_us\": ", opKind[k]);
+			putLatency(json, lat, n);
+			fprintf(json, ",\n    \"recorded_us\": ");
+			putLatency(json, rec, n);
+			fprintf(json, "},\n");
+		}
+		if (n == 0) continue;
+		qsort(lat, n, sizeof(double), cmpDouble);
+		qsort(rec, n, sizeof(double), cmpDouble);
+		printf("%-8s %8ld %10.1f %10.1f %10.1f %10.1f %12.1f %12.1f\n",
+		       opKind[k], n, pct(lat, n, 0.5), pct(lat, n, 0.9),
+		       pct(lat, n, 0.99), 1e6*lat[n-1], pct(rec, n, 0.5), pct(rec, n, 0.99));
+	}
+	for (long i = 0; i < rp.nops; i++) lat[i] = rp.ops[i].lag;
+	if (json != NULL) {
+		fprintf(json, "  \"lag_us\": ");
+		putLatency(json, lat, rp.nops);
+		fprintf(json, "\n}\n");
+		fclose(json);
+	}
+	qsort(lat, rp.nops, sizeof(double), cmpDouble);
+	if (speed > 0)
+		printf("lag      %8ld %10.1f %10.1f %10.1f %10.1f\n", rp.nops,
+		       pct(lat, rp.nops, 0.5), pct(lat, rp.nops, 0.9),
+		       pct(lat, rp.nops, 0.99), 1e6*lat[rp.nops-1]);
+	if (mismatches > 0)
+		printf("%ld select(s) found a different number of matches than recorded\n",
+		       mismatches);
+
+	// clean up
+
+	free(lat);
+	free(rec);
+	fclose(rp.sink);
+	if (rp.parts != NULL) closeParts(rp.parts);
+	if (rp.r != NULL) closeRelation(rp.r);
+	for (long i = 0; i < rp.nops; i++) free(rp.ops[i].arg);
+	free(rp.ops);
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+// sample.c ... random samples of the tuples in a relation
+// part of Multi-attribute Linear-hashed Files
+// Picks n distinct tuples, each equally likely, without
+//   reading pages that hold none of them
+
+#include "defs.h"
+#include "sample.h"
+#include "reln.h"
+#include "page.h"
+#include "lob.h"
+
+// The per-bucket tuple counters number the tuples of the relation
+//   0..N-1, bucket by bucket and, within a bucket, in chain order
+// - positions are chosen by selection sampling (Knuth's
+//   Algorithm S), so a bucket is picked in proportion to its
+//   tuple count, and its chosen positions come out in order
+// - a bucket's chain is then read only as far as the page that
+//   holds its last chosen tuple; buckets with none aren't read
+// - the generator is xorshift64*, so a seed gives the same
+//   sample on any platform
+
+// #tuples in a sample of percent% of r (at least one,
+//   if there are any tuples and percent > 0)
+
+Count sampleSize(Reln r, double percent)
+{
+	if (percent <= 0) return 0;
+	if (percent >= 100) return ntuples(r);
+	Count n = (Count)(percent/100.0 * ntuples(r) + 0.5);
+	if (n == 0 && ntuples(r) > 0) n = 1;
+	return n;
+}
+
+// write the chosen tuples of bucket b; pos[] holds the
+//   positions of the chosen tuples within the bucket, ascending
+
+static void sampleBucket(Reln r, PageID b, Count *pos, Count npos, FILE *out)
+{
+	char *buf = NULL;  // for tuples with values in rel.lob
+	int size = 0;
+	PageScan scan;
+	Tuple tup;
+	Page p;
+	Count i = 0, k = 0;  // i'th chosen tuple is at position pos[i]
+	for (p = firstBucketPage(r, b); p != NULL; p = nextBucketPage(r, p)) {
+		startPageScan(&scan, p, nattrs(r), layout(r));
+		while ((tup = nextPageTuple(&scan)) != NULL) {
+			if (k++ != pos[i]) continue;
+			fprintf(out, "%s\n", lobResolve(lobFile(r), tup, &buf, &size));
+			if (++i == npos) break;
+		}
+		if (i == npos) { free(p); break; }
+	}
+	free(buf);
+}
+
+// write a random sample of n tuples of r, chosen using seed
+// returns the number of tuples written
+
+Count sampleRelation(Reln r, Count n, unsigned long seed, FILE *out)
+{
+	BucketStats *bs = bucketStats(r);
+	unsigned long long state = seed * 0x9E3779B97F4A7C15ULL + 1;
+	Count left = ntuples(r);  // positions not yet considered
+	Count need = n;           // tuples not yet chosen
+	Count *pos = NULL, maxpos = 0;
+	PageID b;
+	if (state == 0) state = 1;
+	if (need > left) need = left;
+	n = need;
+	for (b = 0; b < npages(r) && need > 0; b++) {
+		Count k, npos = 0;
+		for (k = 0; k < bs[b].ntuples && need > 0; k++, left--) {
+			if (left * nextUnit(&state) >= need) continue;
+			if (npos == maxpos) {
+				maxpos = maxpos == 0 ? 64 : 2*maxpos;
+				pos = realloc(pos, maxpos*sizeof(Count));
+				assert(pos != NULL);
+			}
+			pos[npos++] = k;
+			need--;
+		}
+		if (npos > 0) sampleBucket(r, b, pos, npos, out);
+	}
+	free(pos);
+	return n - need;
+}
@@ -0,0 +1,14 @@
+// sample.h ... interface to random sampling of relations
+// part of Multi-attribute Linear-hashed Files
+// See sample.c for details of functions
+
+#ifndef SAMPLE_H
+#define SAMPLE_H 1
+
+#include "defs.h"
+#include "reln.h"
+
+Count sampleSize(Reln r, double percent);
+Count sampleRelation(Reln r, Count n, unsigned long seed, FILE *out);
+
+#endif
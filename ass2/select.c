@@ -1,16 +1,33 @@
 // select.c ... run queries
 // part of Multi-attribute linear-hashed files
 // Ask a query on a named relation
-// Usage:  ./select  [-v]  RelName  v1,v2,v3,v4,...
+// Usage:  ./select  [-v]  [-c]  [-n N]  [-p a,b,...]  [-j J]  RelName  v1,v2,v3,v4,...
+//    or:  ./select  [-v]  --sample P  [--seed S]  RelName
 // where any of the vi's can be "?" (unknown)
+// -v reports scan throughput and pages read on stderr
+// -c prints only the number of matching tuples
+// -n N stops after the first N matching tuples
+// -p a,b,... prints only attributes a,b,... (numbered from 0)
+// -j J scans up to J partitions of a partitioned relation at
+//   once (default: one per CPU); output is the same for any J
+// --sample P prints a random P% of the tuples, reading only the
+//   pages that hold them; --seed S picks the sample (default 1)
 
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
 #include "defs.h"
 #include "query.h"
 #include "tuple.h"
 #include "reln.h"
 #include "chvec.h"
+#include "page.h"
+#include "sample.h"
+#include "part.h"
 
-#define USAGE "./select  [-v]  RelName  v1,v2,v3,v4,..."
+#define USAGE "./select  [-v]  [-c]  [-n N]  [-p a,b,...]  [-j J]  RelName  v1,v2,v3,v4,...\n" \
+              "   or: ./select  [-v]  --sample P  [--seed S]  RelName"
+#define BATCHSIZE 256      // max tuple refs fetched per scan call
+#define OUTBUFSIZE 65536   // bytes of output collected per write
 
 // Main ... process args, run query
 
@@ -18,23 +35,97 @@ int main(int argc, char **argv)
 {
 	Reln r;  // handle on the open relation
 	Query q;  // processed version of query string
-	Tuple t;  // tuple pointer
 	char err[MAXERRMSG];  // buffer for error messages
 	int verbose;  // show extra info on query progress
+	int countOnly;  // just count matching tuples
+	int limit;    // max tuples to return (0 = all)
+	char *proj;   // attributes to output (NULL = all)
+	double sample;  // % of tuples to sample (< 0 = run query)
+	unsigned long seed;  // picks the sample
+	int nthreads;  // partitions scanned at once
 	char *rname;  // name of table/file
 	char *qstr;   // query string
 
 	// process command-line args
 
 	if (argc < 3) fatal(USAGE);
-	if (strcmp(argv[1], "-v") == 0) {
-		verbose = 1;  rname = argv[2];  qstr = argv[3];
-	}
-	else {
-		verbose = 0;  rname = argv[1];  qstr = argv[2];
+	verbose = 0;  countOnly = 0;  limit = 0;  proj = NULL;
+	sample = -1;  seed = 1;  nthreads = 0;
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[arg], "-c") == 0)
+			countOnly = 1;
+		else if (strcmp(argv[arg], "-n") == 0 && arg+1 < argc) {
+			limit = atoi(argv[++arg]);
+			if (limit < 1) fatal(USAGE);
+		}
+		else if (strcmp(argv[arg], "-p") == 0 && arg+1 < argc)
+			proj = argv[++arg];
+		else if (strcmp(argv[arg], "-j") == 0 && arg+1 < argc) {
+			nthreads = atoi(argv[++arg]);
+			if (nthreads < 1) fatal(USAGE);
+		}
+		else if (strcmp(argv[arg], "--sample") == 0 && arg+1 < argc) {
+			sample = atof(argv[++arg]);
+			if (sample < 0 || sample > 100) fatal(USAGE);
+		}
+		else if (strcmp(argv[arg], "--seed") == 0 && arg+1 < argc)
+			seed = strtoul(argv[++arg], NULL, 10);
+		else
+			fatal(USAGE);
+		arg++;
 	}
+	if (argc - arg < (sample < 0 ? 2 : 1)) fatal(USAGE);
+	rname = argv[arg];  qstr = argv[arg+1];
+
+	// a partitioned relation's partitions are scanned in parallel;
+	//   a sample of it is a sample of each partition
 
-	if (verbose) { /* keeps compiler quiet */ }
+	if (isPartitioned(rname)) {
+		Parts parts = openParts(rname,"r");
+		if (parts == NULL) {
+			sprintf(err, "Can't open partitions of relation: %s",rname);
+			fatal(err);
+		}
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		long ntuples = 0;
+		int nscan = nparts(parts);
+		if (sample >= 0) {
+			for (Count i = 0; i < nparts(parts); i++) {
+				Reln pr = partReln(parts, i);
+				ntuples += sampleRelation(pr, sampleSize(pr, sample),
+				                          seed + i, stdout);
+			}
+		}
+		else {
+			Count *which = malloc(nparts(parts)*sizeof(Count));
+			assert(which != NULL);
+			nscan = queryParts(parts, qstr, which);
+			free(which);
+			ntuples = scanParts(parts, qstr, proj, limit, countOnly,
+			                    nthreads, stdout);
+			if (ntuples < 0) {
+				sprintf(err, "Invalid query or projection: %s",qstr);
+				fatal(err);
+			}
+			if (countOnly) printf("%ld\n", ntuples);
+		}
+		fflush(stdout);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (verbose) {
+			double secs = (end.tv_sec - start.tv_sec)
+			              + (end.tv_nsec - start.tv_nsec)/1e9;
+			fprintf(stderr, "%ld tuples in %.6fs (%.0f tuples/sec), %d pages read, "
+			        "%d of %d partitions\n", ntuples, secs,
+			        secs > 0 ? ntuples/secs : 0.0, pagesRead(),
+			        nscan, nparts(parts));
+		}
+		closeParts(parts);
+		return 0;
+	}
 
 	// initialise relation and scanning structure
 
@@ -46,17 +137,70 @@ int main(int argc, char **argv)
 		sprintf(err, "Can't open relation: %s",rname);
 		fatal(err);
 	}
+	if (sample >= 0) {
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		Count want = sampleSize(r, sample);
+		Count before = pagesRead();
+		Count got = sampleRelation(r, want, seed, stdout);
+		fflush(stdout);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (verbose) {
+			double secs = (end.tv_sec - start.tv_sec)
+			              + (end.tv_nsec - start.tv_nsec)/1e9;
+			fprintf(stderr, "%d of %d tuples sampled, %d pages read, %.3fs\n",
+			        got, ntuples(r), pagesRead() - before, secs);
+		}
+		closeRelation(r);
+		return 0;
+	}
 	if ((q = startQuery(r, qstr)) == NULL) {	
 		sprintf(err, "Invalid query: %s",qstr);
 		fatal(err);
 	}
+	if (proj != NULL && projectQuery(q, proj) != OK) {
+		sprintf(err, "Invalid projection: %s",proj);
+		fatal(err);
+	}
 
 	// execute the query (find matching tuples)
+	// fetch a page worth of matches at a time, and
+	//   collect them in a large buffer before writing
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (limit > 0) limitQuery(q, limit);
+	TupleRef refs[BATCHSIZE];
+	char *out = malloc(OUTBUFSIZE);
+	assert(out != NULL);
+	int used = 0, n, i;
+	long ntuples = 0;
+	if (countOnly) {
+		ntuples = countMatches(q);
+		used = sprintf(out, "%ld\n", ntuples);
+	}
+	else while ((n = getNextTuples(q, refs, BATCHSIZE)) > 0) {
+		for (i = 0; i < n; i++) {
+			if (used + refs[i].len + 1 > OUTBUFSIZE) {
+				fwrite(out, 1, used, stdout);
+				used = 0;
+			}
+			memcpy(out+used, refs[i].tup, refs[i].len);
+			used += refs[i].len;
+			out[used++] = '\n';
+		}
+		ntuples += n;
+	}
+	fwrite(out, 1, used, stdout);
+	fflush(stdout);
+	free(out);
+	clock_gettime(CLOCK_MONOTONIC, &end);
 
-	char tup[MAXTUPLEN];
-	while ((t = getNextTuple(q)) != NULL) {
-		tupleString(t,tup);
-		printf("%s\n",tup);
+	if (verbose) {
+		double secs = (end.tv_sec - start.tv_sec)
+		              + (end.tv_nsec - start.tv_nsec)/1e9;
+		fprintf(stderr, "%ld tuples in %.6fs (%.0f tuples/sec), %d pages read\n",
+		        ntuples, secs, secs > 0 ? ntuples/secs : 0.0, pagesRead());
 	}
 
 	// clean up
@@ -1,12 +1,15 @@
 // stats.c ... show statistics for a Relation
 // part of Multi-attribute linear-hashed files
 // Show info and page stats for a Relation
-// Usage:  ./stats  RelName
+// Usage:  ./stats  [--verify]  RelName
+// --verify also reads every page to check the bucket counters
+// For a partitioned relation, shows each partition's size
 
 #include "defs.h"
 #include "reln.h"
+#include "part.h"
 
-#define USAGE "./stats  RelName"
+#define USAGE "./stats  [--verify]  RelName"
 
 
 // Main ... process args, run query
@@ -16,17 +19,30 @@ int main(int argc, char **argv)
 	// process command-line args
 
 	if (argc < 2) fatal(USAGE);
-	char *relname = argv[1];
+	int verify = (strcmp(argv[1], "--verify") == 0);
+	if (verify && argc < 3) fatal(USAGE);
+	char *relname = argv[verify ? 2 : 1];
 
 	// open relation and show stats
 
+	if (isPartitioned(relname)) {
+		Parts parts = openParts(relname,"r");
+		if (parts == NULL) fatal("Can't open partitions of relation");
+		partsStats(parts);
+		Count nbad = 0;
+		for (Count i = 0; verify && i < nparts(parts); i++)
+			nbad += verifyRelationStats(partReln(parts, i));
+		closeParts(parts);
+		return nbad == 0 ? 0 : 1;
+	}
 	if (!existsRelation(relname))
 		fatal("No such relation\n");
 	Reln r = openRelation(relname,"r");
 	if (r == NULL) fatal("No such relation");
 
 	relationStats(r);
+	Count nbad = verify ? verifyRelationStats(r) : 0;
 	closeRelation(r);
 
-	return 0;
+	return nbad == 0 ? 0 : 1;
 }
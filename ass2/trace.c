@@ -0,0 +1,163 @@
+// trace.c ... recording and reading workload traces
+// part of Multi-attribute Linear-hashed Files
+// When the environment variable LHTRACE names a file, every insert
+//   and select done through the library is appended to it, so that
+//   a workload can be replayed later by ./replay
+// - the trace is a text file, starting with "# lhtrace 1", then
+//   one operation per line:
+//     I  start  secs  RelName  tuple
+//     S  start  secs  RelName  #matches  query
+//   where start is when it began (seconds since the epoch, so that
+//   traces from several processes interleave properly) and secs is
+//   how long it took (for a select, from startQuery() to
+//   closeQuery(), so including the caller's use of the matches)
+// - each line is appended with a single write(), so several
+//   processes can record to the same trace at once
+// - an insert into a partitioned relation is recorded once, for
+//   the partitioned relation, not for the partition it goes to
+// - any thread may record; suspending is process-wide, since the
+//   smaller operations may be done by other threads (as scanParts()
+//   does), so while any thread has suspended, none records
+
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "defs.h"
+#include "trace.h"
+
+#define TRACEHEADER "# lhtrace 1\n"
+
+static int traceFd = -1;   // trace file (-1 = none)
+static pthread_once_t traceOpened = PTHREAD_ONCE_INIT;
+static int suspended = 0;  // traceSuspend()s not yet resumed
+static char *line = NULL;  // record being formed
+static int lineSize = 0;
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+
+// open the trace file named by LHTRACE, if there is one
+// (done once, by whichever thread first asks tracing())
+
+static void openTrace()
+{
+	char *fname = getenv(TRACEVAR);
+	if (fname == NULL || *fname == '\0') return;
+	int fd = open(fname, O_WRONLY|O_APPEND|O_CREAT, 0644);
+	if (fd < 0) fatal("Can't open trace file");
+	if (lseek(fd, 0, SEEK_END) == 0
+	    && write(fd, TRACEHEADER, strlen(TRACEHEADER)) < 0)
+		fatal("Can't write trace file");
+	traceFd = fd;
+}
+
+// is this process recording a trace?
+// (the trace file is opened the first time this is asked)
+
+Bool tracing()
+{
+	if (__sync_fetch_and_add(&suspended, 0) > 0) return FALSE;
+	pthread_once(&traceOpened, openTrace);
+	return traceFd >= 0;
+}
+
+// seconds since the epoch, as used for start times
+
+double traceClock()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_REALTIME, &t);
+	return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// stop (and restart) recording, e.g. while an operation that is
+//   recorded itself is done by smaller ones that shouldn't be
+
+void traceSuspend() { __sync_fetch_and_add(&suspended, 1); }
+
+void traceResume() { __sync_fetch_and_sub(&suspended, 1); }
+
+// append a record, made from prefix and rest, to the trace
+
+static void putRecord(char *prefix, char *rest)
+{
+	pthread_mutex_lock(&traceLock);
+	int plen = strlen(prefix), rlen = strlen(rest);
+	if (lineSize < plen + rlen + 2) {
+		lineSize = plen + rlen + 2;
+		line = realloc(line, lineSize);
+		assert(line != NULL);
+	}
+	memcpy(line, prefix, plen);
+	memcpy(line + plen, rest, rlen);
+	line[plen + rlen] = '\n';
+	if (write(traceFd, line, plen + rlen + 1) < 0)
+		fatal("Can't write trace file");
+	pthread_mutex_unlock(&traceLock);
+}
+
+// record the insert of tuple t into rel, which began at start
+
+void traceInsert(char *rel, char *t, double start)
+{
+	char prefix[MAXFILENAME+64];
+	if (!tracing()) return;
+	snprintf(prefix, sizeof(prefix), "%c %.6f %.6f %s ",
+	         TRACE_INSERT, start, traceClock() - start, rel);
+	putRecord(prefix, t);
+}
+
+// record query q on rel, which began at start and found nfound
+
+void traceSelect(char *rel, char *q, double start, long nfound)
+{
+	char prefix[MAXFILENAME+96];
+	if (!tracing()) return;
+	snprintf(prefix, sizeof(prefix), "%c %.6f %.6f %s %ld ",
+	         TRACE_SELECT, start, traceClock() - start, rel, nfound);
+	putRecord(prefix, q);
+}
+
+// split off the next space-separated field of *c
+
+static char *nextField(char **c)
+{
+	char *f = *c;
+	char *end = strchr(f, ' ');
+	if (end == NULL) return NULL;
+	*end = '\0';
+	*c = end + 1;
+	return f;
+}
+
+// read the next operation from trace in into op
+// op's strings are in *buf (of *size bytes, as for readLine()), so
+//   they only last until the next call
+// returns FALSE at the end of the trace; a line that isn't a
+//   valid operation is fatal
+
+Bool readTraceOp(FILE *in, TraceOp *op, char **buf, int *size)
+{
+	char *c;
+	do {
+		if ((c = readLine(in, buf, size)) == NULL) return FALSE;
+	} while (*c == '#' || *c == '\0');
+	char *kind = nextField(&c);
+	char *at = nextField(&c);
+	char *secs = nextField(&c);
+	op->rel = nextField(&c);
+	if (kind == NULL || at == NULL || secs == NULL || op->rel == NULL
+	    || (kind[0] != TRACE_INSERT && kind[0] != TRACE_SELECT) || kind[1] != '\0')
+		fatal("Bad trace record");
+	op->kind = kind[0];
+	op->at = atof(at);
+	op->secs = atof(secs);
+	op->nfound = 0;
+	if (op->kind == TRACE_SELECT) {
+		char *n = nextField(&c);
+		if (n == NULL) fatal("Bad trace record");
+		op->nfound = atol(n);
+	}
+	op->arg = c;
+	return TRUE;
+}
@@ -0,0 +1,36 @@
+// trace.h ... interface to recording and reading workload traces
+// part of Multi-attribute Linear-hashed Files
+// See trace.c for details of the trace format and functions
+
+#ifndef TRACE_H
+#define TRACE_H 1
+
+#include "defs.h"
+
+// recording is turned on by naming the trace file in this
+//   environment variable
+#define TRACEVAR "LHTRACE"
+
+// kinds of operation recorded
+#define TRACE_INSERT 'I'
+#define TRACE_SELECT 'S'
+
+// one operation read back from a trace
+typedef struct TraceOp {
+	char kind;     // TRACE_INSERT or TRACE_SELECT
+	double at;     // when it started (seconds since the epoch)
+	double secs;   // how long it took
+	char *rel;     // relation name
+	long nfound;   // #matches (selects only)
+	char *arg;     // the tuple inserted, or the query string
+} TraceOp;
+
+Bool tracing();
+double traceClock();
+void traceInsert(char *rel, char *t, double start);
+void traceSelect(char *rel, char *q, double start, long nfound);
+void traceSuspend();
+void traceResume();
+Bool readTraceOp(FILE *in, TraceOp *op, char **buf, int *size);
+
+#endif
@@ -8,6 +8,7 @@
 #include "hash.h"
 #include "chvec.h"
 #include "bits.h"
+#include "lob.h"
 
 // return number of bytes/chars in a tuple
 
@@ -17,21 +18,29 @@ int tupLength(Tuple t)
 }
 
 // reads/parses next tuple in input
+// returns NULL at the end of input or on a tuple with the wrong
+//   number of values; a tuple containing LOBREF is fatal
 
 Tuple readTuple(Reln r, FILE *in)
 {
-	char line[MAXTUPLEN];
-	if (fgets(line, MAXTUPLEN-1, in) == NULL)
+	char *line = NULL;
+	int size = 0;
+	if (readLine(in, &line, &size) == NULL) {
+		free(line);
 		return NULL;
-	line[strlen(line)-1] = '\0';
+	}
 	// count fields
 	// cheap'n'nasty parsing
 	char *c; int nf = 1;
-	for (c = line; *c != '\0'; c++)
+	for (c = line; *c != '\0'; c++) {
 		if (*c == ',') nf++;
+		// would be mistaken for a value stored in rel.lob
+		if (*c == LOBREF) fatal("Tuple contains a reserved character");
+	}
 	// invalid tuple
-	if (nf != nattrs(r)) return NULL;
-	return copyString(line); // needs to be free'd sometime
+	Tuple t = (nf == nattrs(r)) ? copyString(line) : NULL;
+	free(line);
+	return t; // needs to be free'd sometime
 }
 
 // extract values into an array of strings
@@ -66,11 +75,19 @@ void freeVals(char **vals, int nattrs)
 }
 
 // hash a tuple using the choice vector
-// TODO: actually use the choice vector to make the hash
 
-Bits tupleHash(Reln r, Tuple t)
+HashBits tupleHash(Reln r, Tuple t)
+{
+	Bits hashVals[MAXATTRS];
+	return tupleAttrHash(r, t, hashVals);
+}
+
+// hash a tuple using the choice vector, and also
+// leave each attribute's own hash value in hashVals[]
+
+HashBits tupleAttrHash(Reln r, Tuple t, Bits *hashVals)
 {
-	char buf[MAXBITS+1];
+	char buf[MAXBITS+MAXBITS/8+1];
 
 	// read attribute vals
     Count nvals = nattrs(r);
@@ -79,13 +96,17 @@ Bits tupleHash(Reln r, Tuple t)
 	tupleVals(t, vals);
 
 	// compute attribute hash vals
-    Bits hashVals[nvals];
     for (int i = 0; i < nvals; i++) {
-        hashVals[i] = hash_any((unsigned char *)vals[i],strlen(vals[i]));
+        int len = strlen(vals[i]);
+        // values in rel.lob keep their hash in the reference
+        if (isLobRef(vals[i], len))
+            hashVals[i] = lobRefHash(vals[i]);
+        else
+            hashVals[i] = hash_any((unsigned char *)vals[i], len);
     }
 
 	// compute malHash using choice vector and hashVals
-    Bits malHash = 0;
+    HashBits malHash = 0;
     ChVecItem *cv = chvec(r);
     for (int i = 0; i < MAXCHVEC; i++) {
         if (bitIsSet(hashVals[cv[i].att], cv[i].bit)) {
@@ -94,6 +115,7 @@ Bits tupleHash(Reln r, Tuple t)
     }
 	bitsString(malHash,buf);
     freeVals(vals, (int)nvals);
+    free(vals);
     return malHash;
 }
 
@@ -115,9 +137,36 @@ Bool tupleMatch(Reln r, Tuple t1, Tuple t2)
 		match = FALSE;
 	}
 	freeVals(v1,na); freeVals(v2,na);
+	free(v1); free(v2);
 	return match;
 }
 
+// find value of attribute a in tuple t (not '\0'-terminated)
+// returns its start, and its length in *len
+
+char *tupleAttr(Tuple t, Count a, int *len)
+{
+	char *c = t;
+	while (a > 0) {
+		while (*c != ',' && *c != '\0') c++;
+		assert(*c == ',');
+		c++; a--;
+	}
+	char *v = c;
+	while (*c != ',' && *c != '\0') c++;
+	*len = c - v;
+	return v;
+}
+
+// order two attribute values as strcmp() would order them
+
+int compareVals(char *v1, int len1, char *v2, int len2)
+{
+	int n = memcmp(v1, v2, len1 < len2 ? len1 : len2);
+	if (n != 0) return n;
+	return len1 - len2;
+}
+
 // puts printable version of tuple in user-supplied buffer
 
 void tupleString(Tuple t, char *buf)
@@ -15,10 +15,13 @@ typedef char *Tuple;
 
 int tupLength(Tuple t);
 Tuple readTuple(Reln r, FILE *in);
-Bits tupleHash(Reln r, Tuple t);
+HashBits tupleHash(Reln r, Tuple t);
+HashBits tupleAttrHash(Reln r, Tuple t, Bits *hashVals);
 void tupleVals(Tuple t, char **vals);
 void freeVals(char **vals, int nattrs);
 Bool tupleMatch(Reln r, Tuple t1, Tuple t2);
 void tupleString(Tuple t, char *buf);
+char *tupleAttr(Tuple t, Count a, int *len);
+int compareVals(char *v1, int len1, char *v2, int len2);
 
 #endif
@@ -0,0 +1,43 @@
+// upgrade.c ... rewrite an old relation in the current format
+// part of Multi-attribute linear-hashed files
+// Relations made before 64-bit choice vectors can be read, but
+//   must be upgraded before they can be updated
+// Usage:  ./upgrade  [-v]  RelName
+// -v shows the choice vector after upgrading
+
+#include "defs.h"
+#include "reln.h"
+#include "chvec.h"
+
+#define USAGE "./upgrade  [-v]  RelName"
+
+// Main ... process args, upgrade relation
+
+int main(int argc, char **argv)
+{
+	int verbose = 0;
+	int arg = 1;
+	if (arg < argc && strcmp(argv[arg], "-v") == 0) {
+		verbose = 1;
+		arg++;
+	}
+	if (arg >= argc) fatal(USAGE);
+	char *rname = argv[arg];
+	char err[MAXERRMSG];
+
+	if (!existsRelation(rname)) {
+		sprintf(err, "No such relation: %s",rname);
+		fatal(err);
+	}
+	if (upgradeRelation(rname) != OK) {
+		sprintf(err, "Can't upgrade relation: %s",rname);
+		fatal(err);
+	}
+	if (verbose) {
+		Reln r = openRelation(rname,"r");
+		if (r == NULL) fatal("Can't open relation");
+		printChVec(chvec(r));
+		closeRelation(r);
+	}
+	return 0;
+}
@@ -4,9 +4,12 @@
 //   obvious data types like File, Query, ...
 // Last modified by John Shepherd, July 2019
 
+#define _POSIX_C_SOURCE 199309L
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include "util.h"
 
 void fatal(char *msg)
 {
@@ -20,3 +23,103 @@ char *copyString(char *str)
 	strcpy(new, str);
 	return new;
 }
+
+// read a line of any length into *buf (of *size bytes), growing
+//   it as needed; the trailing newline is dropped
+// returns *buf, or NULL at end of file
+
+char *readLine(FILE *in, char **buf, int *size)
+{
+	if (*buf == NULL || *size < 2) {
+		*size = 256;
+		*buf = realloc(*buf, *size);
+	}
+	int len = 0;
+	for (;;) {
+		if (fgets(*buf + len, *size - len, in) == NULL) {
+			if (len == 0) return NULL;
+			break;
+		}
+		len += strlen(*buf + len);
+		if ((*buf)[len-1] == '\n') {
+			(*buf)[--len] = '\0';
+			break;
+		}
+		if (len < *size - 1) break;  // last line, with no newline
+		*size *= 2;
+		*buf = realloc(*buf, *size);
+	}
+	return *buf;
+}
+
+// seconds since some fixed time (for measuring how long things take)
+
+double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// for qsort()ing doubles into ascending order
+
+int cmpDouble(const void *a, const void *b)
+{
+	double x = *(double *)a, y = *(double *)b;
+	return (x > y) - (x < y);
+}
+
+// the p'th percentile (0 <= p <= 1) of the n (> 0) sorted values in v
+
+double percentile(double *v, long n, double p)
+{
+	return v[(long)(p*(n-1)+0.5)];
+}
+
+// write a JSON object summarising the n latencies (in seconds)
+//   in v, in microseconds; v is sorted as a side-effect
+
+void putLatency(FILE *out, double *v, long n)
+{
+	if (n == 0) {
+		fprintf(out, "{\"n\": 0}");
+		return;
+	}
+	qsort(v, n, sizeof(double), cmpDouble);
+	double sum = 0;
+	for (long i = 0; i < n; i++) sum += v[i];
+	fprintf(out, "{\"n\": %ld, \"mean\": %.3f, \"min\": %.3f, \"p50\": %.3f, "
+	        "\"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+	        n, 1e6*sum/n, 1e6*v[0], 1e6*percentile(v, n, 0.5),
+	        1e6*percentile(v, n, 0.9), 1e6*percentile(v, n, 0.99), 1e6*v[n-1]);
+}
+
+// pseudo-random numbers: xorshift64*, so that a seed gives the
+//   same numbers on any platform; a state must never be 0
+
+unsigned long long nextRandom(unsigned long long *state)
+{
+	unsigned long long x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 2685821657736338717ULL;
+}
+
+// uniform in [0,1)
+
+double nextUnit(unsigned long long *state)
+{
+	return (nextRandom(state) >> 11) * (1.0/9007199254740992.0);
+}
+
+// scramble x (splitmix64's finaliser), e.g. to make a seed
+
+unsigned long long mix64(unsigned long long x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
@@ -9,5 +9,17 @@
 
 void fatal(char *);
 char *copyString(char *);
+char *readLine(FILE *, char **, int *);
+
+// timing
+double now();
+int cmpDouble(const void *, const void *);
+double percentile(double *, long, double);
+void putLatency(FILE *, double *, long);
+
+// random numbers
+unsigned long long nextRandom(unsigned long long *);
+double nextUnit(unsigned long long *);
+unsigned long long mix64(unsigned long long);
 
 #endif
@@ -0,0 +1,101 @@
+// vacuum.c ... compact the overflow chains of a relation
+// part of Multi-attribute linear-hashed files
+// Repacks buckets densely onto consecutive overflow pages
+// Usage:  ./vacuum  [-v]  [-b B]  [-n N]  RelName
+// where -b B starts at bucket B (default 0)
+//       -n N does only N buckets, so that a large relation
+//          can be vacuumed a few buckets at a time
+//       -v shows pages per bucket, page runs per chain and
+//          the time to scan the buckets, before and after
+
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#include "defs.h"
+#include "reln.h"
+#include "page.h"
+#include "part.h"
+
+#define USAGE "./vacuum  [-v]  [-b B]  [-n N]  RelName"
+
+// pages in buckets b..e-1, the number of runs of consecutive
+//   overflow pages in their chains, and the time to read them
+
+static void showBuckets(Reln r, PageID b, PageID e, char *when)
+{
+	struct timespec start, end;
+	Count npg = 0, nruns = 0, nchains = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (PageID i = b; i < e; i++) {
+		PageID prev = NO_PAGE;
+		Page p = firstBucketPage(r, i);
+		if (pageOvflow(p) != NO_PAGE) nchains++;
+		while (p != NULL) {
+			PageID next = pageOvflow(p);
+			if (next != NO_PAGE && (prev == NO_PAGE || next != prev+1))
+				nruns++;
+			prev = next;
+			npg++;
+			p = nextBucketPage(r, p);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double secs = (end.tv_sec - start.tv_sec)
+	              + (end.tv_nsec - start.tv_nsec)/1e9;
+	printf("%s: %.2f pages/bucket, %.2f runs/chain, scan %.3fs\n",
+	       when, (double)npg/(e-b), nchains ? (double)nruns/nchains : 0.0,
+	       secs);
+}
+
+// Main ... process args, vacuum buckets
+
+int main(int argc, char **argv)
+{
+	int verbose = 0;
+	PageID first = 0;
+	Count count = 0;  // 0 = all buckets from first
+	char err[MAXERRMSG];
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[arg], "-b") == 0 && arg+1 < argc)
+			first = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-n") == 0 && arg+1 < argc)
+			count = atoi(argv[++arg]);
+		else
+			fatal(USAGE);
+		arg++;
+	}
+	if (arg >= argc) fatal(USAGE);
+	char *rname = argv[arg];
+
+	if (isPartitioned(rname)) {
+		sprintf(err, "%s is partitioned; vacuum each of its partitions",rname);
+		fatal(err);
+	}
+	if (!existsRelation(rname)) {
+		sprintf(err, "No such relation: %s",rname);
+		fatal(err);
+	}
+	Reln r = openRelation(rname,"r+");
+	if (r == NULL) {
+		sprintf(err, "Can't open relation for writing: %s",rname);
+		fatal(err);
+	}
+	if (first >= npages(r)) fatal("No such bucket");
+	PageID last = npages(r);
+	if (count > 0 && first + count < last) last = first + count;
+
+	if (verbose) showBuckets(r, first, last, "before");
+	for (PageID b = first; b < last; b++) {
+		if (vacuumBucket(r, b) != OK) fatal("Vacuum failed");
+	}
+	if (verbose) {
+		showBuckets(r, first, last, "after ");
+		printf("buckets %d..%d vacuumed, %d free overflow pages\n",
+		       first, last-1, freeOvflowPages(r));
+	}
+	closeRelation(r);
+	return 0;
+}